@@ -0,0 +1,81 @@
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <chrono>
+#include <clocale>
+#include <string_view>
+#include <vector>
+#include "fb/comby/encoding.hpp"
+#include "fb/comby/locale.hpp"
+
+using namespace std::literals;
+using namespace fb::comby::encoding;
+
+std::vector<char> corpus(std::size_t const n, unsigned const ascii_percent, std::string_view const other) {
+	auto out = std::vector<char>{};
+	auto seed = std::uint32_t{42};
+
+	while (out.size() < n) {
+		seed = seed * 1664525u + 1013904223u;
+
+		if ((seed >> 8) % 100 < ascii_percent) {
+			out.push_back(static_cast<char>(0x20 + (seed >> 16) % 0x5F));
+		} else {
+			out.insert(out.end(), other.begin(), other.end());
+		}
+	}
+
+	return out;
+}
+
+template <typename F>
+double measure(std::vector<char> const& units, F&& f) {
+	auto best = std::chrono::duration<double>::max();
+	auto produced = std::size_t{};
+
+	for (auto i = 0; i < 5; ++i) {
+		auto const start = std::chrono::steady_clock::now();
+		produced += f();
+		best = std::min<std::chrono::duration<double>>(best, std::chrono::steady_clock::now() - start);
+	}
+
+	if (!produced) {
+		std::puts("nothing decoded");
+	}
+
+	return static_cast<double>(units.size()) / best.count() / 1e6;
+}
+
+void run(char const* name, std::vector<char> const& units) {
+	auto codes = std::vector<char32_t>(units.size());
+	auto libc_state = state_t<locale>{};
+	auto cached_state = state_t<cached_locale>{};
+
+	cached_locale::reload();
+
+	auto const libc = measure(units, [&] {
+		return decode_all<locale>(libc_state = {}, units, codes).dst.size();
+	});
+
+	auto const cached = measure(units, [&] {
+		return decode_all<cached_locale>(cached_state = {}, units, codes).dst.size();
+	});
+
+	std::printf("%-16s locale %8.1f MB/s  cached_locale %8.1f MB/s\n", name, libc, cached);
+}
+
+int main() {
+	auto const ascii = corpus(4 << 20, 100, "x"sv);
+
+	if (std::setlocale(LC_ALL, "C")) {
+		run("C ascii", ascii);
+	}
+
+	if (std::setlocale(LC_ALL, "C.UTF-8")) {
+		run("C.UTF-8 ascii", ascii);
+		run("C.UTF-8 ascii_95", corpus(4 << 20, 95, "\xC3\xA9\xE4\xB8\xAD"sv));
+		run("C.UTF-8 cjk", corpus(4 << 20, 5, "\xE4\xB8\xAD\xE6\x96\x87"sv));
+	}
+
+	return 0;
+}
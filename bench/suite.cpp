@@ -0,0 +1,787 @@
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <chrono>
+#include <clocale>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+#include "fb/comby/encoding.hpp"
+#include "fb/comby/ascii.hpp"
+#include "fb/comby/utf8.hpp"
+#include "fb/comby/utf16.hpp"
+#include "fb/comby/utf32.hpp"
+#include "fb/comby/locale.hpp"
+#include "fb/comby/bit.hpp"
+#include "fb/comby/dispatch.hpp"
+#include "fb/comby/decode_view.hpp"
+#include "fb/comby/parser.hpp"
+#include "fb/comby/first_set.hpp"
+#include "fb/comby/literal.hpp"
+#include "fb/comby/choice.hpp"
+#include "fb/comby/char_class.hpp"
+#include "fb/comby/operators.hpp"
+#include "fb/comby/parallel.hpp"
+#include "fb/comby/line_index.hpp"
+
+/*
+	the whole benchmark suite in one binary, writing JSON to stdout (or --out <path>) and a
+	readable summary to stderr. every encoding is timed decoding and encoding each corpus,
+	invalid units are replaced and skipped so broken input is timed too. --quick shortens
+	every measurement for a smoke test and --level <name> caps the SIMD kernel level.
+*/
+
+#ifndef CPP_COMBY_VERSION
+#define CPP_COMBY_VERSION "unknown"
+#endif
+
+#ifdef __VERSION__
+#define CPP_COMBY_COMPILER __VERSION__
+#else
+#define CPP_COMBY_COMPILER "unknown"
+#endif
+
+using namespace std::literals;
+using namespace fb::comby::encoding;
+
+namespace {
+	auto budget = std::chrono::duration<double>{0.2};
+
+	struct measurement {
+		std::string kind;
+		std::string subject;
+		std::string corpus;
+		std::size_t bytes;
+		std::size_t items;
+		double seconds;
+	};
+
+	std::vector<measurement> results;
+
+	// the best of as many runs as fit in the budget, at least 3
+	template <typename F>
+	double best_of(F&& f) {
+		auto best = std::chrono::duration<double>::max();
+		auto total = std::chrono::duration<double>::zero();
+		auto sink = std::size_t{};
+
+		for (auto i = 0; i < 3 || (total < budget && i < 1000); ++i) {
+			auto const start = std::chrono::steady_clock::now();
+			sink += f();
+			auto const elapsed = std::chrono::duration<double>{std::chrono::steady_clock::now() - start};
+
+			best = std::min(best, elapsed);
+			total += elapsed;
+		}
+
+		if (!sink) {
+			std::fputs("benchmark produced nothing\n", stderr);
+		}
+
+		return best.count();
+	}
+
+	void record(std::string_view kind, std::string_view subject, std::string_view corpus,
+		    std::size_t const bytes, std::size_t const items, double const seconds)
+	{
+		results.push_back({std::string{kind}, std::string{subject}, std::string{corpus}, bytes, items, seconds});
+		std::fprintf(stderr, "%-8s %-14s %-8s %9.1f MB/s %8.2f ns/item\n",
+			     results.back().kind.c_str(), results.back().subject.c_str(), results.back().corpus.c_str(),
+			     static_cast<double>(bytes) / seconds / 1e6, seconds * 1e9 / static_cast<double>(items ? items : 1));
+	}
+
+	struct lcg {
+		std::uint32_t seed;
+
+		std::uint32_t operator()(std::uint32_t const n) noexcept {
+			seed = seed * 1664525u + 1013904223u;
+			return (seed >> 8) % n;
+		}
+	};
+
+	// code points, the invalid corpus sprinkles lone surrogates in to exercise encode's error path
+	std::vector<char32_t> corpus(std::string_view const name, std::size_t const n) {
+		auto out = std::vector<char32_t>(n);
+		auto next = lcg{42};
+
+		for (auto& cp : out) {
+			auto const ascii = static_cast<char32_t>(next(16) ? 0x20 + next(0x5F) : U'\n');
+
+			if (name == "ascii") {
+				cp = ascii;
+			} else if (name == "cjk") {
+				cp = next(10) ? 0x4E00 + next(0x5200) : ascii;
+			} else if (name == "emoji") {
+				cp = next(2) ? 0x1F300 + next(0x700) : ascii;
+			} else {
+				auto const r = next(64);
+				cp = r == 0 ? 0xD800 + next(0x800) : r < 6 ? 0xA0 + next(0x60) : r < 12 ? 0x4E00 + next(0x5200) : ascii;
+			}
+		}
+
+		return out;
+	}
+
+	// a unit no encoding accepts on its own
+	template <typename E>
+	unit_t<E> invalid_unit() noexcept {
+		if constexpr(sizeof(unit_t<E>) == 1) {
+			return static_cast<unit_t<E>>(0xFF);
+		} else if constexpr(sizeof(unit_t<E>) == 2) {
+			return fb::comby::bit::cond_bswap<E::endian>(static_cast<unit_t<E>>(0xD800));
+		} else {
+			return fb::comby::bit::cond_bswap<E::endian>(static_cast<unit_t<E>>(0x110000));
+		}
+	}
+
+	// decodes everything, writing U+FFFD for and skipping whatever fails
+	template <typename E>
+	std::size_t decode_lossy(std::span<unit_t<E> const> src, std::span<code_t<E>> dst) {
+		auto state = state_t<E>{};
+		auto n = std::size_t{};
+
+		while (!src.empty()) {
+			auto const r = decode_all<E>(state, src, dst.subspan(n));
+
+			n += r.dst.size();
+
+			if (r || r.code == result_code::NOT_ENOUGH_STORAGE) {
+				break;
+			}
+
+			dst[n++] = 0xFFFD;
+			src = src.subspan(std::min(src.size(), r.src.size() + (r.code != result_code::NOT_ENOUGH_INPUT)));
+			state = {};
+		}
+
+		return n;
+	}
+
+	// encodes everything, dropping whatever fails
+	template <typename E>
+	std::size_t encode_lossy(std::span<code_t<E> const> src, std::span<unit_t<E>> dst) {
+		auto state = state_t<E>{};
+		auto n = std::size_t{};
+
+		while (!src.empty()) {
+			auto const r = encode_all<E>(state, src, dst.subspan(n));
+
+			n += r.dst.size();
+
+			if (r || r.code == result_code::NOT_ENOUGH_STORAGE) {
+				break;
+			}
+
+			src = src.subspan(r.src.size() + 1);
+			state = {};
+		}
+
+		return n;
+	}
+
+	template <typename E>
+	void bench_encoding(std::string_view const name, std::size_t const n) {
+		for (auto const corpus_name : {"ascii"sv, "cjk"sv, "emoji"sv, "invalid"sv}) {
+			auto const codes = corpus(corpus_name, n);
+			auto units = std::vector<unit_t<E>>(codes.size() * E::max_units);
+
+			units.resize(encode_lossy<E>(codes, units));
+
+			if (corpus_name == "invalid") {
+				for (auto i = std::size_t{}; i < units.size(); i += 61) {
+					units[i] = invalid_unit<E>();
+				}
+			}
+
+			auto decoded = std::vector<code_t<E>>(units.size());
+			auto const decoded_size = decode_lossy<E>(units, decoded);
+			auto encoded = std::vector<unit_t<E>>(codes.size() * E::max_units);
+			auto const encoded_size = encode_lossy<E>(codes, encoded);
+
+			record("decode", name, corpus_name, units.size() * sizeof(unit_t<E>), decoded_size, best_of([&] {
+				return decode_lossy<E>(units, decoded);
+			}));
+
+			record("encode", name, corpus_name, encoded_size * sizeof(unit_t<E>), codes.size(), best_of([&] {
+				return encode_lossy<E>(codes, encoded);
+			}));
+		}
+	}
+
+	namespace grammar {
+		enum class parse_error {
+			NONE,
+			EXPECTED_DIGIT,
+			EXPECTED_CLOSE,
+			EXPECTED_NEWLINE
+		};
+
+		using iterator = char const*;
+		using result = fb::comby::parser_result<char, std::int64_t, parse_error, iterator, iterator>;
+		using rule = fb::comby::wrapped_parser<char, std::int64_t, parse_error, void(*)(iterator, iterator, result&)>;
+
+		void number(iterator pos, iterator const end, result& r) {
+			auto const start = pos;
+			auto v = std::int64_t{};
+
+			for (; pos != end && *pos >= '0' && *pos <= '9'; ++pos) {
+				v = v * 10 + (*pos - '0');
+			}
+
+			if (pos == start) {
+				r.set_error(parse_error::EXPECTED_DIGIT, pos);
+			} else {
+				r.set_value(v, pos);
+			}
+		}
+
+		inline auto number_rule = rule{&number};
+
+		// number (',' number)* '\n', the value is the sum of the numbers
+		void record(iterator pos, iterator const end, result& r) {
+			auto sum = std::int64_t{};
+
+			while (true) {
+				auto const n = fb::comby::parse(number_rule, pos, end);
+
+				if (n.index() == 0) {
+					r = n;
+					return;
+				}
+
+				sum += n.value();
+				pos = n.pos();
+
+				if (pos == end || *pos != ',') {
+					break;
+				}
+
+				++pos;
+			}
+
+			if (pos == end || *pos != '\n') {
+				r.set_error(parse_error::EXPECTED_NEWLINE, pos);
+			} else {
+				r.set_value(sum, pos + 1);
+			}
+		}
+
+		void expression(iterator pos, iterator end, result& r);
+		inline auto expression_rule = rule{&expression};
+
+		// number | '(' expression ')'
+		void factor(iterator pos, iterator const end, result& r) {
+			if (pos == end || *pos != '(') {
+				r = fb::comby::parse(number_rule, pos, end);
+				return;
+			}
+
+			auto const e = fb::comby::parse(expression_rule, pos + 1, end);
+
+			if (e.index() == 0) {
+				r = e;
+			} else if (e.pos() == end || *e.pos() != ')') {
+				r.set_error(parse_error::EXPECTED_CLOSE, e.pos());
+			} else {
+				r.set_value(e.value(), e.pos() + 1);
+			}
+		}
+
+		inline auto factor_rule = rule{&factor};
+
+		// factor ('*' factor)*
+		void term(iterator pos, iterator const end, result& r) {
+			auto f = fb::comby::parse(factor_rule, pos, end);
+			auto v = std::int64_t{1};
+
+			for (; f.index() == 1; f = fb::comby::parse(factor_rule, f.pos() + 1, end)) {
+				v *= f.value();
+
+				if (f.pos() == end || *f.pos() != '*') {
+					r.set_value(v, f.pos());
+					return;
+				}
+			}
+
+			r = f;
+		}
+
+		inline auto term_rule = rule{&term};
+
+		// term (('+' | '-') term)*
+		void expression(iterator pos, iterator const end, result& r) {
+			auto t = fb::comby::parse(term_rule, pos, end);
+			auto v = std::int64_t{};
+			auto sign = std::int64_t{1};
+
+			for (; t.index() == 1; t = fb::comby::parse(term_rule, t.pos() + 1, end)) {
+				v += sign * t.value();
+
+				if (t.pos() == end || (*t.pos() != '+' && *t.pos() != '-')) {
+					r.set_value(v, t.pos());
+					return;
+				}
+
+				sign = *t.pos() == '+' ? 1 : -1;
+			}
+
+			r = t;
+		}
+
+		// expression '\n'
+		void line(iterator pos, iterator const end, result& r) {
+			r = fb::comby::parse(expression_rule, pos, end);
+
+			if (r.index() == 0) {
+				return;
+			} else if (r.pos() == end || *r.pos() != '\n') {
+				r.set_error(parse_error::EXPECTED_NEWLINE, r.pos());
+			} else {
+				auto const v = r.value();
+				r.set_value(v, r.pos() + 1);
+			}
+		}
+
+		inline auto record_rule = rule{&record};
+		inline auto line_rule = rule{&line};
+
+		void operand(iterator pos, iterator end, result& r);
+		inline auto operand_rule = rule{&operand};
+
+		// the same expressions from an operator table with as many levels as C's, of which the
+		// corpus only uses + - *
+		inline auto const table = fb::comby::operators(operand_rule,
+			fb::comby::infix<"||", 1>([](std::int64_t const a, std::int64_t const b) { return std::int64_t{a || b}; }),
+			fb::comby::infix<"&&", 2>([](std::int64_t const a, std::int64_t const b) { return std::int64_t{a && b}; }),
+			fb::comby::infix<"|", 3>([](std::int64_t const a, std::int64_t const b) { return a | b; }),
+			fb::comby::infix<"^", 4>([](std::int64_t const a, std::int64_t const b) { return a ^ b; }),
+			fb::comby::infix<"&", 5>([](std::int64_t const a, std::int64_t const b) { return a & b; }),
+			fb::comby::infix<"==", 6>([](std::int64_t const a, std::int64_t const b) { return std::int64_t{a == b}; }),
+			fb::comby::infix<"!=", 6>([](std::int64_t const a, std::int64_t const b) { return std::int64_t{a != b}; }),
+			fb::comby::infix<"<", 7>([](std::int64_t const a, std::int64_t const b) { return std::int64_t{a < b}; }),
+			fb::comby::infix<">", 7>([](std::int64_t const a, std::int64_t const b) { return std::int64_t{a > b}; }),
+			fb::comby::infix<"<<", 8>([](std::int64_t const a, std::int64_t const b) { return a << (b & 63); }),
+			fb::comby::infix<">>", 8>([](std::int64_t const a, std::int64_t const b) { return a >> (b & 63); }),
+			fb::comby::infix<"+", 9>([](std::int64_t const a, std::int64_t const b) { return a + b; }),
+			fb::comby::infix<"-", 9>([](std::int64_t const a, std::int64_t const b) { return a - b; }),
+			fb::comby::infix<"*", 10>([](std::int64_t const a, std::int64_t const b) { return a * b; }),
+			fb::comby::infix<"/", 10>([](std::int64_t const a, std::int64_t const b) { return b ? a / b : 0; }),
+			fb::comby::infix<"**", 11, fb::comby::assoc::right>([](std::int64_t const a, std::int64_t const b) { return a * b; }),
+			fb::comby::prefix<"-", 12>([](std::int64_t const a) { return -a; }),
+			fb::comby::prefix<"~", 12>([](std::int64_t const a) { return ~a; }),
+			fb::comby::prefix<"!", 12>([](std::int64_t const a) { return std::int64_t{!a}; }),
+			fb::comby::infix<".", 13>([](std::int64_t const a, std::int64_t const b) { return a + b; }),
+			fb::comby::postfix<"?", 14>([](std::int64_t const a) { return a; }),
+			fb::comby::infix<"::", 15>([](std::int64_t, std::int64_t const b) { return b; }),
+			fb::comby::postfix<"'", 16>([](std::int64_t const a) { return a; }));
+
+		// number | '(' table ')'
+		void operand(iterator pos, iterator const end, result& r) {
+			if (pos == end || *pos != '(') {
+				r = fb::comby::parse(number_rule, pos, end);
+				return;
+			}
+
+			auto const e = fb::comby::parse(table, pos + 1, end);
+
+			if (e.index() == 0) {
+				r = e;
+			} else if (e.pos() == end || *e.pos() != ')') {
+				r.set_error(parse_error::EXPECTED_CLOSE, e.pos());
+			} else {
+				r.set_value(e.value(), e.pos() + 1);
+			}
+		}
+
+		// table '\n'
+		void table_line(iterator pos, iterator const end, result& r) {
+			r = fb::comby::parse(table, pos, end);
+
+			if (r.index() == 0) {
+				return;
+			} else if (r.pos() == end || *r.pos() != '\n') {
+				r.set_error(parse_error::EXPECTED_NEWLINE, r.pos());
+			} else {
+				auto const v = r.value();
+				r.set_value(v, r.pos() + 1);
+			}
+		}
+
+		inline auto table_line_rule = rule{&table_line};
+	}
+
+	// runs p until the input ends or it fails, returning how many times it matched
+	template <typename P, typename It, typename S>
+	std::size_t parse_all(P& p, It pos, S const end) {
+		auto n = std::size_t{};
+
+		while (pos != end) {
+			auto const r = fb::comby::parse(p, pos, end);
+
+			if (r.index() == 0) {
+				break;
+			}
+
+			pos = r.pos();
+			++n;
+		}
+
+		return n;
+	}
+
+	std::string csv_corpus(std::size_t const n) {
+		auto out = std::string{};
+		auto next = lcg{7};
+
+		while (out.size() < n) {
+			for (auto i = next(8); i > 0; --i) {
+				out += std::to_string(next(100000));
+				out += ',';
+			}
+
+			out += std::to_string(next(100000));
+			out += '\n';
+		}
+
+		return out;
+	}
+
+	std::string arithmetic_corpus(std::size_t const n) {
+		auto out = std::string{};
+		auto next = lcg{11};
+		auto const expression = [&](auto const& self, unsigned const depth) -> void {
+			for (auto i = next(4); ; --i) {
+				if (depth && !next(4)) {
+					out += '(';
+					self(self, depth - 1);
+					out += ')';
+				} else {
+					out += std::to_string(next(1000));
+				}
+
+				if (!i) {
+					break;
+				}
+
+				out += "+-*"[next(3)];
+			}
+		};
+
+		while (out.size() < n) {
+			expression(expression, 3);
+			out += '\n';
+		}
+
+		return out;
+	}
+
+	std::string token_corpus(std::size_t const n) {
+		static constexpr auto tokens = std::array{
+			"auto"sv, "break"sv, "case"sv, "char"sv, "const"sv, "continue"sv, "default"sv, "do"sv,
+			"double"sv, "else"sv, "enum"sv, "for"sv, "if"sv, "int"sv, "return"sv, "while"sv,
+			"+"sv, "-"sv, "*"sv, "/"sv, "("sv, ")"sv, "{"sv, "}"sv, ";"sv, "x"sv, "count"sv, "total"sv
+		};
+
+		auto out = std::string{};
+		auto next = lcg{13};
+
+		while (out.size() < n) {
+			out += tokens[next(tokens.size())];
+			out += ' ';
+		}
+
+		return out;
+	}
+
+	// C-ish keywords, operators and identifiers, first through a choice and then by trying each in turn
+	void bench_tokens(std::size_t const n) {
+		auto const text = token_corpus(n);
+		auto const* begin = text.data();
+		auto const* end = text.data() + text.size();
+
+		auto identifier = fb::comby::with_first<fb::comby::first_set::range(U'a', U'z') | fb::comby::first_set::of(U" ")>(
+			fb::comby::as_parser<char, std::string_view, std::monostate>([](auto pos, auto end, auto& r) {
+				auto const start = pos;
+
+				for (; pos != end && ((*pos >= 'a' && *pos <= 'z') || *pos == ' '); ++pos) {}
+
+				if (pos == start) {
+					r.set_error({}, pos);
+				} else {
+					r.set_value(std::string_view{start, pos}, pos);
+				}
+			}));
+
+		auto keywords = fb::comby::choice(
+			fb::comby::literal<"auto">, fb::comby::literal<"break">, fb::comby::literal<"case">, fb::comby::literal<"char">,
+			fb::comby::literal<"const">, fb::comby::literal<"continue">, fb::comby::literal<"default">, fb::comby::literal<"double">,
+			fb::comby::literal<"do">, fb::comby::literal<"else">, fb::comby::literal<"enum">, fb::comby::literal<"for">,
+			fb::comby::literal<"if">, fb::comby::literal<"int">, fb::comby::literal<"return">, fb::comby::literal<"while">,
+			fb::comby::literal<"+">, fb::comby::literal<"-">, fb::comby::literal<"*">, fb::comby::literal<"/">,
+			fb::comby::literal<"(">, fb::comby::literal<")">, fb::comby::literal<"{">, fb::comby::literal<"}">,
+			fb::comby::literal<";">, fb::comby::literal<" ">, identifier);
+
+		auto const alternatives = std::array{
+			"auto"sv, "break"sv, "case"sv, "char"sv, "const"sv, "continue"sv, "default"sv, "double"sv,
+			"do"sv, "else"sv, "enum"sv, "for"sv, "if"sv, "int"sv, "return"sv, "while"sv,
+			"+"sv, "-"sv, "*"sv, "/"sv, "("sv, ")"sv, "{"sv, "}"sv, ";"sv, " "sv
+		};
+
+		auto sequential = fb::comby::as_parser<char, std::string_view, std::monostate>([&](auto pos, auto end, auto& r) {
+			for (auto const alternative : alternatives) {
+				if (static_cast<std::size_t>(end - pos) >= alternative.size() && std::string_view{pos, alternative.size()} == alternative) {
+					r.set_value(alternative, pos + alternative.size());
+					return;
+				}
+			}
+
+			r = fb::comby::parse(identifier, pos, end);
+		});
+
+		record("parse", "tokens_sequential", "tokens", text.size(), parse_all(sequential, begin, end), best_of([&] {
+			return parse_all(sequential, begin, end);
+		}));
+
+		record("parse", "tokens_choice", "tokens", text.size(), parse_all(keywords, begin, end), best_of([&] {
+			return parse_all(keywords, begin, end);
+		}));
+
+		// the same alternatives as one trie, the longest match wins so "do" no longer has to follow "double"
+		auto trie = fb::comby::as_parser<char, std::string_view, std::monostate>([&](auto pos, auto end, auto& r) {
+			static constexpr auto literals = fb::comby::one_of_literals<
+				"auto", "break", "case", "char", "const", "continue", "default", "double", "do", "else", "enum", "for", "if",
+				"int", "return", "while", "+", "-", "*", "/", "(", ")", "{", "}", ";", " ">;
+
+			if (auto const l = fb::comby::parse(literals, pos, end); l.index() == 1) {
+				r.set_value(alternatives[l.value()], l.pos());
+			} else {
+				r = fb::comby::parse(identifier, pos, end);
+			}
+		});
+
+		record("parse", "tokens_literals", "tokens", text.size(), parse_all(trie, begin, end), best_of([&] {
+			return parse_all(trie, begin, end);
+		}));
+	}
+
+	std::string identifier_corpus(std::size_t const n) {
+		auto out = std::string{};
+		auto next = lcg{17};
+
+		while (out.size() < n) {
+			for (auto i = 4 + next(24); i > 0; --i) {
+				out += "abcdefghijklmnopqrstuvwxyz_0123456789ABCDEFGHIJKLMNOPQRSTUVWXYZ"[next(26) + (i % 3 ? 0 : next(38))];
+			}
+
+			out.append(1 + next(3), ' ');
+		}
+
+		return out;
+	}
+
+	// identifiers between runs of spaces, a character at a time and then a class at a time
+	void bench_identifiers(std::size_t const n) {
+		auto const text = identifier_corpus(n);
+		auto const* begin = text.data();
+		auto const* end = text.data() + text.size();
+
+		auto per_char = fb::comby::as_parser<char, std::string_view, std::monostate>([](auto pos, auto end, auto& r) {
+			auto const is_ident = [](char const c) {
+				return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9') || c == '_';
+			};
+
+			for (; pos != end && *pos == ' '; ++pos) {}
+
+			auto const start = pos;
+
+			for (; pos != end && is_ident(*pos); ++pos) {}
+
+			r.set_value(std::string_view{start, pos}, pos);
+		});
+
+		auto per_class = fb::comby::as_parser<char, std::string_view, std::monostate>([](auto pos, auto end, auto& r) {
+			auto const s = fb::comby::parse(fb::comby::skip_while<fb::comby::chars(U" ")>, pos, end);
+			r = fb::comby::parse(fb::comby::take_while<fb::comby::classes::ident>, s.pos(), end);
+		});
+
+		record("parse", "idents_per_char", "idents", text.size(), parse_all(per_char, begin, end), best_of([&] {
+			return parse_all(per_char, begin, end);
+		}));
+
+		record("parse", "idents_class", "idents", text.size(), parse_all(per_class, begin, end), best_of([&] {
+			return parse_all(per_class, begin, end);
+		}));
+	}
+
+	void bench_parsers(std::size_t const n) {
+		bench_tokens(n);
+		bench_identifiers(n);
+
+		auto const csv = csv_corpus(n);
+		auto const arithmetic = arithmetic_corpus(n);
+
+		record("parse", "csv_integers", "csv", csv.size(), parse_all(grammar::record_rule, csv.data(), csv.data() + csv.size()), best_of([&] {
+			return parse_all(grammar::record_rule, csv.data(), csv.data() + csv.size());
+		}));
+
+		// the same records on one thread and on every hardware thread
+		auto thread_counts = std::vector<unsigned>{1};
+
+		if (auto const cores = std::thread::hardware_concurrency(); cores > 1) {
+			thread_counts.push_back(cores);
+		}
+
+		for (auto const threads : thread_counts) {
+			auto const options = fb::comby::record_options{.threads = threads, .chunk_size = 256 << 10};
+			auto const run = [&] {
+				return fb::comby::parse_records(grammar::record_rule, csv.data(), csv.data() + csv.size(), fb::comby::delimited{'\n'}, options).values.size();
+			};
+
+			record("parse", "csv_records_" + std::to_string(threads), "csv", csv.size(), run(), best_of(run));
+		}
+
+		// building the index counts every newline, the lookups then only count within a block
+		auto const lookups = std::size_t{1000};
+
+		record("index", "line_index", "csv", csv.size(), lookups, best_of([&] {
+			auto const index = fb::comby::line_index<ascii>{csv};
+			auto sum = std::size_t{};
+
+			for (auto i = std::size_t{}; i < lookups; ++i) {
+				sum += index.at(csv.size() / lookups * i).line;
+			}
+
+			return sum;
+		}));
+
+		record("parse", "arithmetic", "arith", arithmetic.size(), parse_all(grammar::line_rule, arithmetic.data(), arithmetic.data() + arithmetic.size()), best_of([&] {
+			return parse_all(grammar::line_rule, arithmetic.data(), arithmetic.data() + arithmetic.size());
+		}));
+
+		record("parse", "arithmetic_table", "arith", arithmetic.size(), parse_all(grammar::table_line_rule, arithmetic.data(), arithmetic.data() + arithmetic.size()), best_of([&] {
+			return parse_all(grammar::table_line_rule, arithmetic.data(), arithmetic.data() + arithmetic.size());
+		}));
+
+		// words of letters over code points decoded on the fly, everything else is skipped
+		auto words = fb::comby::as_parser<char32_t, std::size_t, int>([](auto pos, auto end, auto& r) {
+			auto const is_letter = [](char32_t const cp) {
+				return cp >= 0x80u || (cp | 0x20u) - U'a' < 26u;
+			};
+
+			for (; pos != end && !is_letter(*pos); ++pos) {}
+
+			auto length = std::size_t{};
+
+			for (; pos != end && is_letter(*pos); ++pos) {
+				++length;
+			}
+
+			r.set_value(length, pos);
+		});
+
+		for (auto const corpus_name : {"ascii"sv, "cjk"sv}) {
+			auto const codes = corpus(corpus_name, n / 2);
+			auto units = std::vector<char8_t>(codes.size() * utf8::max_units);
+
+			units.resize(encode_lossy<utf8>(codes, units));
+
+			auto const view = units | views::decode<utf8>;
+
+			record("parse", "utf8_words", corpus_name, units.size(), parse_all(words, view.begin(), view.end()), best_of([&] {
+				return parse_all(words, view.begin(), view.end());
+			}));
+		}
+	}
+
+	bool set_level(std::string_view const name) {
+		using fb::comby::dispatch::level;
+
+		for (auto const l : {level::SCALAR, level::SSE2, level::SSE4_2, level::AVX2, level::AVX512}) {
+			if (fb::comby::dispatch::name(l) == name) {
+				if (fb::comby::dispatch::force_level(l) != l) {
+					std::fprintf(stderr, "%s isn't supported here, using %s\n", name.data(),
+						     fb::comby::dispatch::name(fb::comby::dispatch::active_level()).data());
+				}
+
+				return true;
+			}
+		}
+
+		return false;
+	}
+
+	// what every parser hands back to its caller, a char const* range with small values and errors
+	using small_result = fb::comby::parser_result<char, std::int64_t, grammar::parse_error, char const*, char const*>;
+	using utf8_view = decltype(std::declval<std::vector<char8_t>&>() | views::decode<utf8>);
+	using view_result = fb::comby::parser_result<char32_t, std::size_t, int, std::ranges::iterator_t<utf8_view>, std::ranges::sentinel_t<utf8_view>>;
+
+	void write_json(std::FILE* out, std::string_view const locale_name) {
+		std::fprintf(out, "{\n\t\"version\": \"%s\",\n\t\"compiler\": \"%s\",\n\t\"simd\": \"%s\",\n\t\"locale\": \"%.*s\",\n"
+				  "\t\"result_bytes\": {\"small\": %zu, \"decode_view\": %zu},\n\t\"results\": [\n",
+			     CPP_COMBY_VERSION, CPP_COMBY_COMPILER, fb::comby::dispatch::name(fb::comby::dispatch::active_level()).data(), static_cast<int>(locale_name.size()), locale_name.data(),
+			     sizeof(small_result), sizeof(view_result));
+
+		for (auto i = std::size_t{}; i < results.size(); ++i) {
+			auto const& m = results[i];
+
+			std::fprintf(out, "\t\t{\"kind\": \"%s\", \"subject\": \"%s\", \"corpus\": \"%s\", \"bytes\": %zu, \"items\": %zu, "
+					  "\"seconds\": %.9f, \"mb_per_s\": %.3f, \"ns_per_item\": %.4f}%s\n",
+				     m.kind.c_str(), m.subject.c_str(), m.corpus.c_str(), m.bytes, m.items, m.seconds,
+				     static_cast<double>(m.bytes) / m.seconds / 1e6,
+				     m.seconds * 1e9 / static_cast<double>(m.items ? m.items : 1),
+				     i + 1 < results.size() ? "," : "");
+		}
+
+		std::fputs("\t]\n}\n", out);
+	}
+}
+
+int main(int argc, char const* args[]) {
+	auto out_path = static_cast<char const*>(nullptr);
+	auto n = std::size_t{1} << 20;
+
+	for (auto i = 1; i < argc; ++i) {
+		if (!std::strcmp(args[i], "--quick")) {
+			budget = std::chrono::duration<double>{0};
+			n = std::size_t{1} << 14;
+		} else if (!std::strcmp(args[i], "--out") && i + 1 < argc) {
+			out_path = args[++i];
+		} else if (!std::strcmp(args[i], "--level") && i + 1 < argc && set_level(args[++i])) {
+			continue;
+		} else {
+			std::fprintf(stderr, "usage: %s [--quick] [--out <path>] [--level scalar|sse2|sse4.2|avx2|avx512]\n", args[0]);
+			return 1;
+		}
+	}
+
+	// the locale encodings are measured in a UTF-8 locale when there is one
+	auto const locale_name = std::setlocale(LC_ALL, "C.UTF-8") ? "C.UTF-8"sv : "C"sv;
+	cached_locale::reload();
+
+	bench_encoding<ascii>("ascii", n);
+	bench_encoding<utf8>("utf8", n);
+	bench_encoding<utf16_le>("utf16_le", n);
+	bench_encoding<utf16_be>("utf16_be", n);
+	bench_encoding<utf32_le>("utf32_le", n);
+	bench_encoding<utf32_be>("utf32_be", n);
+	bench_encoding<locale>("locale", n / 8);
+	bench_encoding<cached_locale>("cached_locale", n);
+	bench_parsers(n);
+
+	auto* out = out_path ? std::fopen(out_path, "w") : stdout;
+
+	if (!out) {
+		std::perror(out_path);
+		return 1;
+	}
+
+	write_json(out, locale_name);
+
+	if (out != stdout) {
+		std::fclose(out);
+	}
+
+	return 0;
+}
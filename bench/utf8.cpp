@@ -0,0 +1,82 @@
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <array>
+#include <chrono>
+#include <string_view>
+#include <vector>
+#include "fb/comby/encoding.hpp"
+#include "fb/comby/utf8.hpp"
+
+using namespace std::literals;
+using namespace fb::comby::encoding;
+
+std::vector<char8_t> corpus(std::size_t const n, unsigned const ascii_percent, std::u8string_view const other) {
+	auto out = std::vector<char8_t>{};
+	auto seed = std::uint32_t{42};
+
+	while (out.size() < n) {
+		seed = seed * 1664525u + 1013904223u;
+
+		if ((seed >> 8) % 100 < ascii_percent) {
+			out.push_back(static_cast<char8_t>(0x20 + (seed >> 16) % 0x5F));
+		} else {
+			out.insert(out.end(), other.begin(), other.end());
+		}
+	}
+
+	return out;
+}
+
+template <typename F>
+double measure(std::vector<char8_t> const& units, std::vector<char32_t>& codes, F&& f) {
+	auto best = std::chrono::duration<double>::max();
+	auto produced = std::size_t{};
+
+	for (auto i = 0; i < 20; ++i) {
+		auto const start = std::chrono::steady_clock::now();
+		produced += f(units, codes);
+		best = std::min<std::chrono::duration<double>>(best, std::chrono::steady_clock::now() - start);
+	}
+
+	if (!produced) {
+		std::puts("nothing decoded");
+	}
+
+	return static_cast<double>(units.size()) / best.count() / 1e6;
+}
+
+int main() {
+	struct named_corpus {
+		char const* name;
+		std::vector<char8_t> units;
+	};
+
+	auto const corpora = std::array{
+		named_corpus{"ascii", corpus(16 << 20, 100, u8"x"sv)},
+		named_corpus{"ascii_95", corpus(16 << 20, 95, u8"é中"sv)},
+		named_corpus{"cjk", corpus(16 << 20, 5, u8"中文"sv)}
+	};
+
+	auto codes = std::vector<char32_t>(16 << 20);
+	auto state = state_t<utf8>{};
+
+	for (auto const& c : corpora) {
+		auto const scalar = measure(c.units, codes, [&](auto const& units, auto& out) {
+			return detail::decode_each<utf8>(state, units, out).dst.size();
+		});
+
+		auto const bulk = measure(c.units, codes, [&](auto const& units, auto& out) {
+			return decode_all<utf8>(state, units, out).dst.size();
+		});
+
+		auto const validate = measure(c.units, codes, [&](auto const& units, auto&) {
+			return utf8::validate(state, units).src.size();
+		});
+
+		std::printf("%-10s decode %8.1f MB/s  decode_all %8.1f MB/s  validate %8.1f MB/s\n",
+			    c.name, scalar, bulk, validate);
+	}
+
+	return 0;
+}
@@ -0,0 +1,91 @@
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <chrono>
+#include <string_view>
+#include <vector>
+#include "fb/comby/encoding.hpp"
+#include "fb/comby/utf8.hpp"
+#include "fb/comby/utf16.hpp"
+
+using namespace std::literals;
+using namespace fb::comby::encoding;
+
+std::vector<char8_t> corpus(std::size_t const n, unsigned const ascii_percent, std::u8string_view const other) {
+	auto out = std::vector<char8_t>{};
+	auto seed = std::uint32_t{42};
+
+	while (out.size() < n) {
+		seed = seed * 1664525u + 1013904223u;
+
+		if ((seed >> 8) % 100 < ascii_percent) {
+			out.push_back(static_cast<char8_t>(0x20 + (seed >> 16) % 0x5F));
+		} else {
+			out.insert(out.end(), other.begin(), other.end());
+		}
+	}
+
+	return out;
+}
+
+template <typename Src, typename F>
+double measure(std::vector<Src> const& src, F&& f) {
+	auto best = std::chrono::duration<double>::max();
+	auto produced = std::size_t{};
+
+	for (auto i = 0; i < 20; ++i) {
+		auto const start = std::chrono::steady_clock::now();
+		produced += f();
+		best = std::min<std::chrono::duration<double>>(best, std::chrono::steady_clock::now() - start);
+	}
+
+	if (!produced) {
+		std::puts("nothing transcoded");
+	}
+
+	return static_cast<double>(src.size() * sizeof(Src)) / best.count() / 1e6;
+}
+
+template <typename E>
+void run(char const* name, std::vector<char8_t> const& bytes) {
+	auto u8_state = state_t<utf8>{};
+	auto u16_state = state_t<E>{};
+	auto units = std::vector<char16_t>(bytes.size());
+	auto back = std::vector<char8_t>(bytes.size());
+
+	units.resize(transcode<utf8, E>(u8_state, u16_state, bytes, units).dst.size());
+
+	auto const to_pivot = measure(bytes, [&] {
+		return detail::transcode_pivot<utf8, E>(u8_state, u16_state, bytes, units).dst.size();
+	});
+
+	auto const to_direct = measure(bytes, [&] {
+		return transcode<utf8, E>(u8_state, u16_state, bytes, units).dst.size();
+	});
+
+	auto const from_pivot = measure(units, [&] {
+		return detail::transcode_pivot<E, utf8>(u16_state, u8_state, units, back).dst.size();
+	});
+
+	auto const from_direct = measure(units, [&] {
+		return transcode<E, utf8>(u16_state, u8_state, units, back).dst.size();
+	});
+
+	std::printf("%-14s utf8->utf16 pivot %8.1f MB/s direct %8.1f MB/s  utf16->utf8 pivot %8.1f MB/s direct %8.1f MB/s\n",
+		    name, to_pivot, to_direct, from_pivot, from_direct);
+}
+
+int main() {
+	auto const ascii = corpus(16 << 20, 100, u8"x"sv);
+	auto const mixed = corpus(16 << 20, 95, u8"é中"sv);
+	auto const cjk = corpus(16 << 20, 5, u8"中文"sv);
+
+	run<utf16_le>("ascii le", ascii);
+	run<utf16_be>("ascii be", ascii);
+	run<utf16_le>("ascii_95 le", mixed);
+	run<utf16_be>("ascii_95 be", mixed);
+	run<utf16_le>("cjk le", cjk);
+	run<utf16_be>("cjk be", cjk);
+
+	return 0;
+}
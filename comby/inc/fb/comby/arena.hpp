@@ -0,0 +1,48 @@
+#ifndef FB_COMBY_ARENA_HPP
+#define FB_COMBY_ARENA_HPP
+#include <cstddef>
+#include <memory_resource>
+#include <span>
+#include "fb/comby/parser.hpp"
+
+namespace fb::comby {
+	/*
+		monotonic memory for the values of one parse. allocating is a pointer bump, freeing does
+		nothing, so values thrown away while backtracking cost no call into the global allocator
+		and the whole parse is given back by release() or the destructor.
+
+		values built from it must not outlive it, nor be used after release().
+	*/
+	class arena {
+	private:
+		std::pmr::monotonic_buffer_resource m_resource;
+
+	public:
+		// the first block is initial_size bytes, later ones grow geometrically
+		explicit arena(std::size_t const initial_size = 4096, std::pmr::memory_resource* const upstream = std::pmr::get_default_resource()) :
+			m_resource{initial_size, upstream}
+		{}
+
+		// starts in buffer, usually on the stack, and only goes upstream once it is full
+		explicit arena(std::span<std::byte> const buffer, std::pmr::memory_resource* const upstream = std::pmr::get_default_resource()) :
+			m_resource{buffer.data(), buffer.size(), upstream}
+		{}
+
+		arena(arena const&) = delete;
+		arena& operator=(arena const&) = delete;
+
+		std::pmr::memory_resource* resource() noexcept {
+			return &m_resource;
+		}
+
+		parse_context context() noexcept {
+			return parse_context{&m_resource};
+		}
+
+		void release() {
+			m_resource.release();
+		}
+	};
+}
+
+#endif
@@ -1,23 +1,49 @@
 #ifndef FB_COMBY_BIT_HPP
 #define FB_COMBY_BIT_HPP
 #include <climits>
+#include <cstdint>
 #include <bit>
+#include <type_traits>
 #include "fb/comby/concepts.hpp"
 #include "fb/comby/algorithm.hpp"
 
 namespace fb::comby::bit {
+	namespace detail {
+		template <typename I>
+		constexpr I bswap_loop(I const& i) noexcept {
+			using U = std::make_unsigned_t<I>;
+
+			auto const u = static_cast<U>(i);
+			auto j = U{};
+
+			algorithm::for_n<sizeof(I)>([&](std::size_t k) {
+				j |= static_cast<U>(static_cast<U>(u >> (k * CHAR_BIT)) & 0xFFu) << ((sizeof(I) - 1 - k) * CHAR_BIT);
+			});
+
+			return static_cast<I>(j);
+		}
+	}
+
+	// lowers to a single bswap/rev, the builtins are usable in constant expressions too
 	template <concepts::integral I>
 	constexpr I bswap(I const& i) noexcept {
 		static_assert(sizeof(I) > 1, "bswap only makes sense for integrals larger than a byte");
 
-		auto j = I{};
-
-		algorithm::for_n<(sizeof(i) >> 1)>([&](std::size_t k) {
-			j |= (i & (0xFF << (k * CHAR_BIT)))
-			   | (i & (0xFF << (sizeof(I) - k * CHAR_BIT)));
-		});
-
-		return j;
+#if defined(__cpp_lib_byteswap)
+		return std::byteswap(i);
+#elif defined(__GNUC__) || defined(__clang__)
+		if constexpr(sizeof(I) == 2) {
+			return static_cast<I>(__builtin_bswap16(static_cast<std::uint16_t>(i)));
+		} else if constexpr(sizeof(I) == 4) {
+			return static_cast<I>(__builtin_bswap32(static_cast<std::uint32_t>(i)));
+		} else if constexpr(sizeof(I) == 8) {
+			return static_cast<I>(__builtin_bswap64(static_cast<std::uint64_t>(i)));
+		} else {
+			return detail::bswap_loop(i);
+		}
+#else
+		return detail::bswap_loop(i);
+#endif
 	}
 
 	template <std::endian E, typename I>
@@ -0,0 +1,354 @@
+#ifndef FB_COMBY_CHAR_CLASS_HPP
+#define FB_COMBY_CHAR_CLASS_HPP
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <exception>
+#include <iterator>
+#include <limits>
+#include <memory>
+#include <string_view>
+#include <type_traits>
+#include <variant>
+#include "fb/tag_invoke.hpp"
+#include "fb/comby/concepts.hpp"
+#include "fb/comby/parser.hpp"
+#include "fb/comby/first_set.hpp"
+#include "fb/comby/simd.hpp"
+
+namespace fb::comby {
+	struct code_range {
+		char32_t first;
+		char32_t last;
+
+		constexpr bool operator==(code_range const&) const noexcept = default;
+	};
+
+	/*
+		a set of characters. everything up to 0xFF is a 256 bit bitmap, which byte units are
+		classified by in bulk. wider code points are looked up in up to N sorted, disjoint
+		ranges, by binary search. a class is built at compile time and used as a template
+		argument, see chars(), ranges() and the classes namespace.
+	*/
+	template <std::size_t N = 0>
+	struct char_class {
+		std::array<std::uint64_t, 4> bytes{};
+		std::array<code_range, N> wide{};
+		std::size_t wide_size = 0;
+
+		constexpr bool contains(char32_t const c) const noexcept {
+			if (c <= 0xFF) {
+				return (bytes[c >> 6] >> (c & 63)) & 1;
+			}
+
+			auto const end = wide.begin() + wide_size;
+			auto const it = std::upper_bound(wide.begin(), end, c, [](char32_t const v, code_range const& r) {
+				return v < r.first;
+			});
+
+			return it != wide.begin() && c <= std::prev(it)->last;
+		}
+
+		constexpr bool contains_wide() const noexcept {
+			return wide_size;
+		}
+
+		constexpr first_set first() const noexcept {
+			return {bytes, contains_wide(), false};
+		}
+
+		// the one byte missing from a class of every other byte, -1 otherwise
+		constexpr int only_excluded_byte() const noexcept {
+			auto count = 0;
+
+			for (auto const b : bytes) {
+				count += std::popcount(~b);
+			}
+
+			if (count != 1) {
+				return -1;
+			}
+
+			for (auto i = 0; i < 4; ++i) {
+				if (~bytes[i]) {
+					return i * 64 + std::countr_zero(~bytes[i]);
+				}
+			}
+
+			return -1;
+		}
+
+		constexpr char_class& add(code_range r) noexcept {
+			for (; r.first <= 0xFF && r.first <= r.last; ++r.first) {
+				bytes[r.first >> 6] |= std::uint64_t{1} << (r.first & 63);
+			}
+
+			if (r.first > r.last) {
+				return *this;
+			}
+
+			// merge with whatever it touches, keeping the ranges sorted. a class with no room
+			// left for r doesn't compile when built at compile time and terminates otherwise
+			auto merged = std::array<code_range, N>{};
+			auto n = std::size_t{};
+			auto placed = false;
+			auto const put = [&](code_range const x) {
+				if (n == N) {
+					std::terminate();
+				}
+
+				merged[n++] = x;
+			};
+
+			for (auto i = std::size_t{}; i < wide_size; ++i) {
+				auto const w = wide[i];
+
+				if (w.last + 1 < r.first) {
+					put(w);
+				} else if (r.last + 1 < w.first) {
+					if (!placed) {
+						put(r);
+						placed = true;
+					}
+
+					put(w);
+				} else {
+					r = {std::min(r.first, w.first), std::max(r.last, w.last)};
+				}
+			}
+
+			if (!placed) {
+				put(r);
+			}
+
+			wide = merged;
+			wide_size = n;
+			return *this;
+		}
+	};
+
+	// a class of the code points in s, which must all fit a byte, one that doesn't fails to compile
+	consteval char_class<> chars(std::u32string_view const s) noexcept {
+		auto c = char_class<>{};
+
+		for (auto const ch : s) {
+			c.add({ch, ch});
+		}
+
+		return c;
+	}
+
+	template <std::size_t N>
+	constexpr char_class<N> ranges(code_range const (&rs)[N]) noexcept {
+		auto c = char_class<N>{};
+
+		for (auto const& r : rs) {
+			c.add(r);
+		}
+
+		return c;
+	}
+
+	template <std::size_t N, std::size_t M>
+	constexpr char_class<N + M> operator|(char_class<N> const& a, char_class<M> const& b) noexcept {
+		auto c = char_class<N + M>{};
+
+		for (auto i = std::size_t{}; i < c.bytes.size(); ++i) {
+			c.bytes[i] = a.bytes[i] | b.bytes[i];
+		}
+
+		for (auto i = std::size_t{}; i < a.wide_size; ++i) {
+			c.add(a.wide[i]);
+		}
+
+		for (auto i = std::size_t{}; i < b.wide_size; ++i) {
+			c.add(b.wide[i]);
+		}
+
+		return c;
+	}
+
+	// every code point not in a, the complement of N ranges needs at most N + 1
+	template <std::size_t N>
+	constexpr char_class<N + 1> operator~(char_class<N> const& a) noexcept {
+		auto c = char_class<N + 1>{};
+		auto next = char32_t{0x100};
+
+		for (auto i = std::size_t{}; i < c.bytes.size(); ++i) {
+			c.bytes[i] = ~a.bytes[i];
+		}
+
+		for (auto i = std::size_t{}; i < a.wide_size; ++i) {
+			if (a.wide[i].first > next) {
+				c.add({next, a.wide[i].first - 1});
+			}
+
+			next = a.wide[i].last + 1;
+		}
+
+		if (next <= 0x10FFFF) {
+			c.add({next, 0x10FFFF});
+		}
+
+		return c;
+	}
+
+	namespace classes {
+		inline constexpr auto digit = chars(U"0123456789");
+		inline constexpr auto xdigit = digit | chars(U"abcdefABCDEF");
+		inline constexpr auto lower = ranges({{U'a', U'z'}});
+		inline constexpr auto upper = ranges({{U'A', U'Z'}});
+		inline constexpr auto alpha = lower | upper;
+		inline constexpr auto alnum = alpha | digit;
+		inline constexpr auto space = chars(U" \t\n\v\f\r");
+		inline constexpr auto ident_start = alpha | chars(U"_");
+		inline constexpr auto ident = alnum | chars(U"_");
+	}
+
+	namespace detail {
+		template <auto Class>
+		inline constexpr auto byte_class_of = simd::byte_class{Class.bytes};
+
+		template <typename It, typename CharT>
+		concept contiguous_units = std::contiguous_iterator<It> && concepts::same_as<std::iter_value_t<It>, CharT>;
+
+		// a char8_t unit above 0x7F is part of a UTF-8 sequence, which utf8_units.hpp matches whole
+		template <auto Class, typename CharT>
+		inline constexpr bool byte_class_fits = !concepts::same_as<CharT, char8_t> || !(Class.bytes[2] | Class.bytes[3]);
+
+		// how many units from pos on are in Class, a byte buffer is classified in bulk
+		template <auto Class, typename It, typename S>
+		constexpr std::size_t class_run(It const pos, S const end) noexcept {
+			using unit = std::iter_value_t<It>;
+
+			if constexpr(std::contiguous_iterator<It> && std::sized_sentinel_for<S, It> && sizeof(unit) == 1) {
+				if (!std::is_constant_evaluated()) {
+					auto const* p = reinterpret_cast<unsigned char const*>(std::to_address(pos));
+					auto const n = static_cast<std::size_t>(end - pos);
+
+					// everything but one byte, which memchr finds
+					if constexpr(Class.only_excluded_byte() >= 0) {
+						auto const* hit = static_cast<unsigned char const*>(std::memchr(p, Class.only_excluded_byte(), n));
+						return hit ? static_cast<std::size_t>(hit - p) : n;
+					} else {
+						return simd::class_prefix(p, n, byte_class_of<Class>);
+					}
+				}
+			}
+
+			auto n = std::size_t{};
+
+			for (auto it = pos; it != end; ++it, ++n) {
+				auto const c = static_cast<std::make_unsigned_t<unit>>(*it);
+
+				if (!Class.contains(static_cast<char32_t>(c))) {
+					break;
+				}
+			}
+
+			return n;
+		}
+	}
+
+	// one character of Class, which is the value
+	template <auto Class, typename CharT = char, typename E = std::monostate>
+	class class_parser {
+		static_assert(detail::byte_class_fits<Class, CharT>, "a class of UTF-8 units above 0x7F splits sequences, use the utf8_ parsers");
+
+	public:
+		using char_type = CharT;
+		using value_type = CharT;
+		using error_type = E;
+
+		static constexpr first_set first = Class.first();
+
+		template <typename It, typename S>
+		friend constexpr parser_result<char_type, value_type, error_type, It, S> tag_invoke(fb::tag_t<parse>, class_parser const&, It pos, S end) {
+			auto r = parser_result<char_type, value_type, error_type, It, S>{default_result, pos};
+
+			if (pos == end) {
+				return r;
+			}
+
+			// the unit as the input holds it, one too wide for CharT is never in the class
+			auto const c = static_cast<std::make_unsigned_t<std::iter_value_t<It>>>(*pos);
+
+			if (c <= std::numeric_limits<std::make_unsigned_t<char_type>>::max() && Class.contains(static_cast<char32_t>(c))) {
+				r.set_value(static_cast<char_type>(*pos), std::next(pos));
+			}
+
+			return r;
+		}
+	};
+
+	/*
+		the longest run of at least Min characters of Class, found in one step. on a contiguous
+		buffer of byte units the run is classified 16 or 32 bytes at a time, or by memchr when
+		Class is every byte but one. byte units are judged by the bitmap alone, a UTF-8 buffer
+		has to be decoded for the wide ranges to apply.
+
+		take_while's value is a view of the run, which needs a contiguous buffer of CharT.
+		skip_while works on any iterator and its value is the length of the run.
+	*/
+	template <auto Class, typename CharT = char, std::size_t Min = 0, typename E = std::monostate>
+	class take_while_parser {
+		static_assert(detail::byte_class_fits<Class, CharT>, "a class of UTF-8 units above 0x7F splits sequences, use the utf8_ parsers");
+
+	public:
+		using char_type = CharT;
+		using value_type = std::basic_string_view<CharT>;
+		using error_type = E;
+
+		static constexpr first_set first = Min ? Class.first() : Class.first() | first_set::empty_match();
+
+		template <detail::contiguous_units<CharT> It, typename S>
+		friend constexpr parser_result<char_type, value_type, error_type, It, S> tag_invoke(fb::tag_t<parse>, take_while_parser const&, It pos, S end) {
+			auto r = parser_result<char_type, value_type, error_type, It, S>{default_result, pos};
+			auto const n = detail::class_run<Class>(pos, end);
+
+			if (n >= Min) {
+				r.set_value(value_type{std::to_address(pos), n}, pos + static_cast<std::iter_difference_t<It>>(n));
+			}
+
+			return r;
+		}
+	};
+
+	template <auto Class, typename CharT = char, std::size_t Min = 0, typename E = std::monostate>
+	class skip_while_parser {
+		static_assert(detail::byte_class_fits<Class, CharT>, "a class of UTF-8 units above 0x7F splits sequences, use the utf8_ parsers");
+
+	public:
+		using char_type = CharT;
+		using value_type = std::size_t;
+		using error_type = E;
+
+		static constexpr first_set first = Min ? Class.first() : Class.first() | first_set::empty_match();
+
+		template <typename It, typename S>
+		friend constexpr parser_result<char_type, value_type, error_type, It, S> tag_invoke(fb::tag_t<parse>, skip_while_parser const&, It pos, S end) {
+			auto r = parser_result<char_type, value_type, error_type, It, S>{default_result, pos};
+			auto const n = detail::class_run<Class>(pos, end);
+
+			if (n >= Min) {
+				r.set_value(n, std::next(pos, static_cast<std::iter_difference_t<It>>(n)));
+			}
+
+			return r;
+		}
+	};
+
+	template <auto Class, typename CharT = char, typename E = std::monostate>
+	inline constexpr class_parser<Class, CharT, E> one_of = {};
+
+	template <auto Class, typename CharT = char, std::size_t Min = 0, typename E = std::monostate>
+	inline constexpr take_while_parser<Class, CharT, Min, E> take_while = {};
+
+	template <auto Class, typename CharT = char, std::size_t Min = 0, typename E = std::monostate>
+	inline constexpr skip_while_parser<Class, CharT, Min, E> skip_while = {};
+}
+
+#endif
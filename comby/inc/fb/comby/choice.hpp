@@ -0,0 +1,169 @@
+#ifndef FB_COMBY_CHOICE_HPP
+#define FB_COMBY_CHOICE_HPP
+#include <cstddef>
+#include <cstdint>
+#include <array>
+#include <bit>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <variant>
+#include "fb/tag_invoke.hpp"
+#include "fb/comby/concepts.hpp"
+#include "fb/comby/parser.hpp"
+#include "fb/comby/first_set.hpp"
+
+namespace fb::comby {
+	namespace detail {
+		template <typename... Vs>
+		struct choice_value {
+			using type = std::variant<Vs...>;
+		};
+
+		template <typename V, typename... Vs>
+		requires (concepts::same_as<V, Vs> && ...)
+		struct choice_value<V, Vs...> {
+			using type = V;
+		};
+	}
+
+	/*
+		ordered choice, the first branch to succeed wins. the lookahead character picks the
+		branches whose first sets allow it from a table built at compile time, so a branch
+		that can't match is never run. only when first sets overlap, or a branch is nullable,
+		is more than one branch tried for the same character.
+
+		the value is the branches' value if they all share one, otherwise a variant indexed
+		by branch. without a viable branch the error is a default constructed error_type,
+		otherwise it is the error of the last branch tried.
+	*/
+	template <typename P, typename... Ps>
+	requires (sizeof...(Ps) < 64)
+	      && (concepts::same_as<parser_char_t<P>, parser_char_t<Ps>> && ...)
+	      && (concepts::same_as<parser_error_t<P>, parser_error_t<Ps>> && ...)
+	class choice_parser {
+	public:
+		using char_type = parser_char_t<P>;
+		using value_type = typename detail::choice_value<parser_value_t<P>, parser_value_t<Ps>...>::type;
+		using error_type = parser_error_t<P>;
+
+		static constexpr std::size_t size = sizeof...(Ps) + 1;
+		static constexpr first_set first = (first_set_v<P> | ... | first_set_v<Ps>);
+
+	private:
+		using mask_type = std::uint64_t;
+
+		static constexpr auto firsts = std::array<first_set, size>{first_set_v<P>, first_set_v<Ps>...};
+
+		// the branches to try for each lookahead byte, bit i for branch i
+		static constexpr auto byte_masks = []() {
+			auto masks = std::array<mask_type, 256>{};
+
+			for (auto c = std::size_t{}; c < masks.size(); ++c) {
+				for (auto i = std::size_t{}; i < size; ++i) {
+					if (firsts[i].nullable || firsts[i].contains(static_cast<char32_t>(c))) {
+						masks[c] |= mask_type{1} << i;
+					}
+				}
+			}
+
+			return masks;
+		}();
+
+		static constexpr mask_type branches_where(bool (*pred)(first_set const&)) noexcept {
+			auto mask = mask_type{};
+
+			for (auto i = std::size_t{}; i < size; ++i) {
+				if (pred(firsts[i])) {
+					mask |= mask_type{1} << i;
+				}
+			}
+
+			return mask;
+		}
+
+		static constexpr mask_type wide_mask = branches_where([](first_set const& f) { return f.nullable || f.wide; });
+		static constexpr mask_type end_mask = branches_where([](first_set const& f) { return f.nullable; });
+
+		std::tuple<P, Ps...> m_parsers;
+
+		template <typename It, typename S>
+		using result_type = parser_result<char_type, value_type, error_type, It, S>;
+
+		template <std::size_t I, typename Self, typename It, typename S, typename... Cs>
+		static constexpr bool try_branch(Self& p, It pos, S end, result_type<It, S>& r, Cs&... ctx) {
+			auto b = parse(std::get<I>(p.m_parsers), pos, end, ctx...);
+
+			if (b.index() == 0) {
+				r.set_error(std::move(b.error()), b.pos());
+				return false;
+			}
+
+			if constexpr(std::is_same_v<value_type, parser_value_t<std::tuple_element_t<I, std::tuple<P, Ps...>>>>) {
+				r.set_value(std::move(b.value()), b.pos());
+			} else {
+				r.set_value(value_type{std::in_place_index<I>, std::move(b.value())}, b.pos());
+			}
+
+			return true;
+		}
+
+		// one entry per branch, indexed by the bits of the lookahead's mask
+		template <typename Self, typename It, typename S, typename... Cs>
+		static constexpr auto jump_table = []<std::size_t... Is>(std::index_sequence<Is...>) {
+			return std::array{&try_branch<Is, Self, It, S, Cs...>...};
+		}(std::make_index_sequence<size>());
+
+	public:
+		// whether no lookahead ever lets more than one branch through
+		static constexpr bool disjoint = []() {
+			for (auto const mask : byte_masks) {
+				if (std::popcount(mask) > 1) {
+					return false;
+				}
+			}
+
+			return std::popcount(wide_mask) <= 1 && std::popcount(end_mask) <= 1;
+		}();
+
+		explicit constexpr choice_parser(P p, Ps... ps) :
+			m_parsers{std::move(p), std::move(ps)...}
+		{}
+
+		// with or without a context, which is passed on to every branch tried. the branches are
+		// parsed const when the choice is
+		template <typename Self, typename It, typename S, typename... Cs>
+		requires concepts::same_as<std::remove_const_t<Self>, choice_parser> && (sizeof...(Cs) <= 1)
+		friend constexpr result_type<It, S> tag_invoke(fb::tag_t<parse>, Self& p, It pos, S end, Cs&... ctx) {
+			auto r = result_type<It, S>{default_result, pos};
+			auto mask = end_mask;
+
+			if (pos != end) {
+				auto const c = static_cast<std::make_unsigned_t<char_type>>(*pos);
+				mask = c <= 0xFF ? byte_masks[c] : wide_mask;
+			}
+
+			if (!mask) {
+				r.set_error(error_type{}, pos);
+				return r;
+			}
+
+			do {
+				if (jump_table<Self, It, S, Cs...>[std::countr_zero(mask)](p, pos, end, r, ctx...)) {
+					break;
+				}
+
+				mask &= mask - 1;
+			} while (mask);
+
+			return r;
+		}
+	};
+
+	template <typename... Ps>
+	constexpr choice_parser<std::remove_cvref_t<Ps>...> choice(Ps&&... ps) {
+		return choice_parser<std::remove_cvref_t<Ps>...>{std::forward<Ps>(ps)...};
+	}
+}
+
+#endif
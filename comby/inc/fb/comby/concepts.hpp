@@ -36,7 +36,8 @@ namespace fb::comby::concepts {
 
 	template <typename I>
 	concept integral = type_in_list<std::remove_cvref_t<I>,
-					char, unsigned char,
+					char, signed char, unsigned char,
+					char8_t, char16_t, char32_t, wchar_t,
 					short, unsigned short,
 					int, unsigned int,
 					long, unsigned long,
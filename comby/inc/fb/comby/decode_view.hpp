@@ -0,0 +1,182 @@
+#ifndef FB_COMBY_DECODE_VIEW_HPP
+#define FB_COMBY_DECODE_VIEW_HPP
+#include <cstddef>
+#include <cstdint>
+#include <algorithm>
+#include <array>
+#include <iterator>
+#include <memory>
+#include <ranges>
+#include <span>
+#include "fb/comby/encoding.hpp"
+
+namespace fb::comby::encoding {
+	/*
+		a forward view of the code points in a range of units, decoded one at a time as the
+		iterator advances. an iterator is the underlying position plus the code point found
+		there, so copying one to backtrack is cheap and base() gives the unit position back.
+
+		malformed or truncated input is yielded as U+FFFD and skipped a unit at a time,
+		iterator::code() tells the replacement apart from a real U+FFFD.
+	*/
+	template <encoding E, std::ranges::view R>
+	requires std::ranges::forward_range<R const>
+	      && concepts::same_as<std::ranges::range_value_t<R>, unit_t<E>>
+	class decode_view : public std::ranges::view_interface<decode_view<E, R>> {
+	public:
+		static constexpr code_t<E> replacement = 0xFFFDu;
+
+		class iterator {
+		public:
+			using iterator_concept = std::forward_iterator_tag;
+			using iterator_category = std::input_iterator_tag;
+			using value_type = code_t<E>;
+			using difference_type = std::ranges::range_difference_t<R const>;
+			using base_iterator = std::ranges::iterator_t<R const>;
+			using base_sentinel = std::ranges::sentinel_t<R const>;
+
+		private:
+			base_iterator m_pos{};
+			base_sentinel m_end{};
+			[[no_unique_address]] state_t<E> m_state{};
+			value_type m_value{};
+			std::uint8_t m_len{};
+			result_code m_code{};
+
+			constexpr decode_result<E> decode_at(std::span<code_t<E>> dst) {
+				if constexpr(std::ranges::contiguous_range<R const> && std::sized_sentinel_for<base_sentinel, base_iterator>) {
+					auto const n = std::min<std::size_t>(E::max_units, static_cast<std::size_t>(m_end - m_pos));
+					return E::decode(m_state, std::span<unit_t<E> const>{std::to_address(m_pos), n}, dst);
+				} else {
+					auto units = std::array<unit_t<E>, E::max_units>{};
+					auto n = std::size_t{};
+
+					for (auto it = m_pos; n < units.size() && it != m_end; ++it) {
+						units[n++] = *it;
+					}
+
+					auto const r = E::decode(m_state, std::span<unit_t<E> const>{units.data(), n}, dst);
+
+					// the spans point into units, only the code and sizes are meaningful
+					return {r.code, std::span<unit_t<E> const>{units.data(), r.src.size()}, r.dst};
+				}
+			}
+
+			constexpr void read() {
+				if (m_pos == m_end) {
+					m_len = 0;
+					return;
+				}
+
+				auto codes = std::array<code_t<E>, E::max_codes>{};
+				auto const r = decode_at(codes);
+
+				m_code = r.code;
+
+				if (r) {
+					m_value = codes[0];
+					m_len = static_cast<std::uint8_t>(r.src.size());
+				} else {
+					// the range really ends here, an incomplete sequence can't be resumed
+					m_state = {};
+					m_value = replacement;
+					m_len = r.code == result_code::INVALID_CODE_POINT && !r.src.empty()
+					      ? static_cast<std::uint8_t>(r.src.size())
+					      : 1;
+				}
+			}
+
+		public:
+			constexpr iterator() = default;
+
+			constexpr iterator(base_iterator pos, base_sentinel end) :
+				m_pos{std::move(pos)},
+				m_end{std::move(end)}
+			{
+				read();
+			}
+
+			constexpr value_type operator*() const noexcept {
+				return m_value;
+			}
+
+			constexpr iterator& operator++() {
+				std::ranges::advance(m_pos, m_len);
+				read();
+				return *this;
+			}
+
+			constexpr iterator operator++(int) {
+				auto copy = *this;
+				++*this;
+				return copy;
+			}
+
+			// the position of the first unit of the current code point
+			constexpr base_iterator const& base() const noexcept {
+				return m_pos;
+			}
+
+			// OK, or why the current code point is the replacement character
+			constexpr result_code code() const noexcept {
+				return m_code;
+			}
+
+			// the number of units the current code point was decoded from
+			constexpr std::size_t units() const noexcept {
+				return m_len;
+			}
+
+			friend constexpr bool operator==(iterator const& a, iterator const& b) {
+				return a.m_pos == b.m_pos;
+			}
+
+			friend constexpr bool operator==(iterator const& a, std::default_sentinel_t) {
+				return a.m_pos == a.m_end;
+			}
+		};
+
+	private:
+		R m_base;
+
+	public:
+		constexpr decode_view() = default;
+
+		explicit constexpr decode_view(R base) :
+			m_base{std::move(base)}
+		{}
+
+		constexpr R base() const& {
+			return m_base;
+		}
+
+		constexpr iterator begin() const {
+			return {std::ranges::begin(m_base), std::ranges::end(m_base)};
+		}
+
+		constexpr std::default_sentinel_t end() const noexcept {
+			return std::default_sentinel;
+		}
+	};
+
+	namespace views {
+		template <encoding E>
+		struct decode_t {
+			template <std::ranges::viewable_range R>
+			constexpr auto operator()(R&& r) const {
+				return decode_view<E, std::views::all_t<R>>{std::views::all(std::forward<R>(r))};
+			}
+
+			template <std::ranges::viewable_range R>
+			friend constexpr auto operator|(R&& r, decode_t const& self) {
+				return self(std::forward<R>(r));
+			}
+		};
+
+		// units | views::decode<E>
+		template <encoding E>
+		inline constexpr decode_t<E> decode = {};
+	}
+}
+
+#endif
@@ -0,0 +1,127 @@
+#ifndef FB_COMBY_DISPATCH_HPP
+#define FB_COMBY_DISPATCH_HPP
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <algorithm>
+#include <atomic>
+#include <string_view>
+
+/*
+	with GCC or Clang on x86-64 every kernel level is compiled with target attributes and the
+	one to run is picked from the cpu at runtime, so a binary built for the baseline still
+	uses AVX2 or AVX-512 where it can. define FB_COMBY_NO_DISPATCH to only use the kernels
+	the translation unit was compiled for.
+*/
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__)) && !defined(FB_COMBY_NO_DISPATCH)
+#define FB_COMBY_DISPATCH 1
+#define FB_COMBY_TARGET(features) __attribute__((target(features)))
+#else
+#define FB_COMBY_TARGET(features)
+#endif
+
+namespace fb::comby::simd::detail {
+	struct kernel_table;
+}
+
+namespace fb::comby::dispatch {
+	enum class level : std::uint8_t {
+		SCALAR, // portable SWAR kernels
+		SSE2,
+		SSE4_2, // and SSSE3
+		AVX2,
+		AVX512 // AVX-512 F, BW and VL
+	};
+
+	constexpr std::string_view name(level const l) noexcept {
+		switch (l) {
+			case level::SCALAR: return "scalar";
+			case level::SSE2: return "sse2";
+			case level::SSE4_2: return "sse4.2";
+			case level::AVX2: return "avx2";
+			case level::AVX512: return "avx512";
+		}
+
+		return "unknown";
+	}
+
+	namespace detail {
+		inline level detect_level() noexcept {
+#if defined(FB_COMBY_DISPATCH)
+			__builtin_cpu_init();
+
+			if (__builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512bw") && __builtin_cpu_supports("avx512vl")) {
+				return level::AVX512;
+			} else if (__builtin_cpu_supports("avx2")) {
+				return level::AVX2;
+			} else if (__builtin_cpu_supports("sse4.2") && __builtin_cpu_supports("ssse3")) {
+				return level::SSE4_2;
+			}
+
+			return level::SSE2;
+#elif defined(__AVX512F__) && defined(__AVX512BW__) && defined(__AVX512VL__)
+			return level::AVX512;
+#elif defined(__AVX2__)
+			return level::AVX2;
+#elif defined(__SSE4_2__) && defined(__SSSE3__)
+			return level::SSE4_2;
+#elif defined(__SSE2__)
+			return level::SSE2;
+#else
+			return level::SCALAR;
+#endif
+		}
+
+		// FB_COMBY_SIMD_LEVEL in the environment caps the level, for comparing them without a rebuild
+		inline level initial_level(level const supported) noexcept {
+			auto const* env = std::getenv("FB_COMBY_SIMD_LEVEL");
+
+			if (!env) {
+				return supported;
+			}
+
+			for (auto const l : {level::SCALAR, level::SSE2, level::SSE4_2, level::AVX2, level::AVX512}) {
+				if (name(l) == env) {
+					return std::min(l, supported);
+				}
+			}
+
+			return supported;
+		}
+	}
+
+	// the best level this cpu (or, without runtime dispatch, this build) can run
+	inline level supported_level() noexcept {
+		static auto const supported = detail::detect_level();
+		return supported;
+	}
+
+	namespace detail {
+		inline std::atomic<level>& active() noexcept {
+			static auto l = std::atomic<level>{initial_level(supported_level())};
+			return l;
+		}
+
+		// the active level's kernels, looked up by simd.hpp on first use and set by force_level()
+		inline constinit std::atomic<simd::detail::kernel_table const*> selected_kernels = nullptr;
+	}
+
+	// the level the kernels are currently picked for
+	inline level active_level() noexcept {
+		return detail::active().load(std::memory_order_relaxed);
+	}
+
+	/*
+		runs the kernels of level l from now on, or of the supported level if l is beyond it.
+		returns the level actually in use. meant for tests and benchmarks, every level gives
+		the same results so switching while other threads decode is harmless.
+
+		it is defined in simd.hpp next to the kernel tables it picks from, which is included
+		below so that either header brings it.
+	*/
+	inline level force_level(level l) noexcept;
+}
+
+#include "fb/comby/simd.hpp"
+
+#endif
@@ -1,7 +1,10 @@
 #ifndef FB_CPP_COMBY_ENCODING_HPP
 #define FB_CPP_COMBY_ENCODING_HPP
 #include <cstddef>
+#include <cstdint>
 #include <type_traits>
+#include <algorithm>
+#include <array>
 #include <ranges>
 #include <span>
 #include <string_view>
@@ -13,11 +16,12 @@ namespace fb::comby::encoding {
 	template <typename E> using code_t = typename E::code_type;
 	template <typename E> using state_t = typename E::state_type;
 
-	enum class result_code {
+	enum class result_code : std::uint8_t {
 		OK,
 		NOT_ENOUGH_STORAGE,
 		INVALID_CODE_POINT,
-		INVALID_ENCODING
+		INVALID_ENCODING,
+		NOT_ENOUGH_INPUT // src ended mid sequence, the units are kept in the state for the next call
 	};
 
 	template <typename E>
@@ -65,6 +69,190 @@ namespace fb::comby::encoding {
 		};
 	};
 
+	template <typename From, typename To>
+	struct transcode_result {
+		result_code code;
+		std::span<unit_t<From> const> src;
+		std::span<unit_t<To>> dst;
+
+		constexpr operator bool() const noexcept {
+			return code == result_code::OK;
+		}
+	};
+
+	/*
+		bulk conversion of whole spans. on return src is the consumed prefix of the input and
+		dst the produced prefix of the output, so on failure src.size() is the position of the
+		first unit (or code) that could not be converted. unlike encode/decode, these check the
+		remaining storage and return NOT_ENOUGH_STORAGE rather than writing past dst.
+
+		an encoding can supply its own kernels as static decode_all/encode_all members with the
+		same signature as decode/encode, and a pair of encodings can specialise transcoder with a
+		static transcode to skip the code point pivot. a kernel must stop on a code point
+		boundary with the state matching what it consumed, the same as the fallbacks below.
+	*/
+	template <typename From, typename To>
+	struct transcoder {};
+
+	namespace detail {
+		// units a failed conversion still consumed, incomplete input lives on in the state
+		template <typename R>
+		constexpr std::size_t consumed_by_failure(R const& r) noexcept {
+			return r.code == result_code::NOT_ENOUGH_INPUT ? r.src.size() : 0;
+		}
+
+		template <typename E>
+		concept has_decode_all = requires(state_t<E>& state,
+						  std::span<unit_t<E> const> src,
+						  std::span<code_t<E>> dst) {
+			{E::decode_all(state, src, dst)} -> concepts::same_as<decode_result<E>>;
+		};
+
+		template <typename E>
+		concept has_encode_all = requires(state_t<E>& state,
+						  std::span<code_t<E> const> src,
+						  std::span<unit_t<E>> dst) {
+			{E::encode_all(state, src, dst)} -> concepts::same_as<encode_result<E>>;
+		};
+
+		template <typename From, typename To>
+		concept has_transcoder = requires(state_t<From>& from,
+						  state_t<To>& to,
+						  std::span<unit_t<From> const> src,
+						  std::span<unit_t<To>> dst) {
+			{transcoder<From, To>::transcode(from, to, src, dst)} -> concepts::same_as<transcode_result<From, To>>;
+		};
+
+		// calls f(state, src, dst) once per code point until src is exhausted or f fails
+		template <typename R, std::size_t N, typename State, typename T, typename U, typename F>
+		constexpr R convert_each(State& state, std::span<T const> src, std::span<U> dst, F&& f) {
+			auto buf = std::array<U, N>{};
+			auto src_pos = std::size_t{};
+			auto dst_pos = std::size_t{};
+
+			while (src_pos < src.size()) {
+				auto const left = dst.size() - dst_pos;
+				auto const out = left < N ? std::span<U>{buf} : dst.subspan(dst_pos);
+				auto const saved = state;
+				auto const r = f(state, src.subspan(src_pos), out);
+
+				if (!r) {
+					return {r.code, src.first(src_pos + consumed_by_failure(r)), dst.first(dst_pos)};
+				} else if (out.data() == buf.data()) {
+					if (r.dst.size() > left) {
+						state = saved;
+						return {result_code::NOT_ENOUGH_STORAGE, src.first(src_pos), dst.first(dst_pos)};
+					}
+
+					std::ranges::copy(r.dst, dst.begin() + dst_pos);
+				}
+
+				src_pos += r.src.size();
+				dst_pos += r.dst.size();
+			}
+
+			return {result_code::OK, src.first(src_pos), dst.first(dst_pos)};
+		}
+
+		template <typename E>
+		constexpr decode_result<E> decode_each(state_t<E>& state,
+						       std::span<unit_t<E> const> src,
+						       std::span<code_t<E>> dst)
+		{
+			return convert_each<decode_result<E>, E::max_codes>(state, src, dst, [](auto& s, auto in, auto out) {
+				return E::decode(s, in, out);
+			});
+		}
+
+		template <typename E>
+		constexpr encode_result<E> encode_each(state_t<E>& state,
+						       std::span<code_t<E> const> src,
+						       std::span<unit_t<E>> dst)
+		{
+			return convert_each<encode_result<E>, E::max_units>(state, src, dst, [](auto& s, auto in, auto out) {
+				return E::encode(s, in, out);
+			});
+		}
+	}
+
+	template <typename E>
+	constexpr decode_result<E> decode_all(state_t<E>& state,
+					      std::span<unit_t<E> const> src,
+					      std::span<code_t<E>> dst)
+	{
+		if constexpr(detail::has_decode_all<E>) {
+			return E::decode_all(state, src, dst);
+		} else {
+			return detail::decode_each<E>(state, src, dst);
+		}
+	}
+
+	template <typename E>
+	constexpr encode_result<E> encode_all(state_t<E>& state,
+					      std::span<code_t<E> const> src,
+					      std::span<unit_t<E>> dst)
+	{
+		if constexpr(detail::has_encode_all<E>) {
+			return E::encode_all(state, src, dst);
+		} else {
+			return detail::encode_each<E>(state, src, dst);
+		}
+	}
+
+	namespace detail {
+		/*
+			code points are pivoted through a small stack buffer. when encoding stops early the
+			block is decoded again up to the failing code point to find how many source units
+			it corresponds to.
+		*/
+		template <typename From, typename To>
+		constexpr transcode_result<From, To> transcode_pivot(state_t<From>& from,
+								     state_t<To>& to,
+								     std::span<unit_t<From> const> src,
+								     std::span<unit_t<To>> dst)
+		{
+			auto codes = std::array<code_t<From>, 256>{};
+			auto src_pos = std::size_t{};
+			auto dst_pos = std::size_t{};
+
+			while (src_pos < src.size()) {
+				auto const saved = from;
+				auto const d = decode_all<From>(from, src.subspan(src_pos), codes);
+				auto const e = encode_all<To>(to, d.dst, dst.subspan(dst_pos));
+
+				if (!e) {
+					from = saved;
+					auto const redo = decode_all<From>(from, src.subspan(src_pos), std::span{codes}.first(e.src.size()));
+
+					return {e.code, src.first(src_pos + redo.src.size()), dst.first(dst_pos + e.dst.size())};
+				}
+
+				src_pos += d.src.size();
+				dst_pos += e.dst.size();
+
+				if (!d && d.code != result_code::NOT_ENOUGH_STORAGE) {
+					return {d.code, src.first(src_pos), dst.first(dst_pos)};
+				}
+			}
+
+			return {result_code::OK, src.first(src_pos), dst.first(dst_pos)};
+		}
+	}
+
+	template <typename From, typename To>
+	requires concepts::same_as<code_t<From>, code_t<To>>
+	constexpr transcode_result<From, To> transcode(state_t<From>& from,
+						       state_t<To>& to,
+						       std::span<unit_t<From> const> src,
+						       std::span<unit_t<To>> dst)
+	{
+		if constexpr(detail::has_transcoder<From, To>) {
+			return transcoder<From, To>::transcode(from, to, src, dst);
+		} else {
+			return detail::transcode_pivot<From, To>(from, to, src, dst);
+		}
+	}
+
 	constexpr bool is_ascii(char32_t const cp) noexcept {
 		return cp < 0x80u;
 	}
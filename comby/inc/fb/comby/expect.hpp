@@ -0,0 +1,204 @@
+#ifndef FB_COMBY_EXPECT_HPP
+#define FB_COMBY_EXPECT_HPP
+#include <cstddef>
+#include <cstdint>
+#include <algorithm>
+#include <iterator>
+#include <limits>
+#include <memory_resource>
+#include <type_traits>
+#include <utility>
+#include <vector>
+#include "fb/tag_invoke.hpp"
+#include "fb/comby/concepts.hpp"
+#include "fb/comby/parser.hpp"
+#include "fb/comby/first_set.hpp"
+#include "fb/comby/memo.hpp"
+
+namespace fb::comby {
+	/*
+		cheap failures. a failed expect() is only a position and the id of what was expected,
+		which fits a register and costs nothing to throw away when an alternative backtracks.
+		while parsing with a failure_context the furthest failure is remembered; if the whole
+		parse fails it is parsed once more in diagnostic mode, gathering every id expected at
+		that position into a diagnostic. a successful parse never builds one.
+	*/
+	using expected_id = std::uint32_t;
+
+	inline constexpr expected_id no_expected = std::numeric_limits<expected_id>::max();
+
+	// the error of an expect(), where it failed is the position of the result
+	struct failure {
+		expected_id expected = no_expected;
+
+		constexpr bool operator==(failure const&) const noexcept = default;
+	};
+
+	// where the parse got furthest before failing and everything that would have let it go on
+	struct diagnostic {
+		std::size_t offset = 0;
+		std::vector<expected_id> expected;
+	};
+
+	// also a memo_context, so memoized rules are cached while failures are tracked
+	template <std::random_access_iterator It>
+	class failure_context : public memo_context<It> {
+	public:
+		using iterator = It;
+
+	private:
+		std::size_t m_furthest = 0;
+		expected_id m_id = no_expected;
+		bool m_diagnosing = false;
+		std::vector<expected_id> m_expected;
+
+	public:
+		explicit failure_context(iterator const begin, std::pmr::memory_resource* const resource = std::pmr::get_default_resource()) :
+			memo_context<It>{begin, resource}
+		{}
+
+		// a new input, forgetting the failures of the last one along with the memo tables
+		void reset(iterator const begin) noexcept {
+			memo_context<It>::reset(begin);
+			m_furthest = 0;
+			m_id = no_expected;
+			m_diagnosing = false;
+			m_expected.clear();
+		}
+
+		constexpr void fail(iterator const pos, expected_id const id) {
+			auto const offset = this->offset(pos);
+
+			if (m_diagnosing) {
+				if (offset == m_furthest && std::find(m_expected.begin(), m_expected.end(), id) == m_expected.end()) {
+					m_expected.push_back(id);
+				}
+			} else if (m_id == no_expected || offset > m_furthest) {
+				m_furthest = offset;
+				m_id = id;
+			}
+		}
+
+		/*
+			the next parse of the same input gathers what was expected at the furthest failure
+			so far. the memo tables are cleared, cached results would skip recording it.
+		*/
+		void diagnose() noexcept {
+			memo_context<It>::reset(this->begin());
+			m_diagnosing = true;
+			m_expected.clear();
+		}
+
+		constexpr bool diagnosing() const noexcept {
+			return m_diagnosing;
+		}
+
+		constexpr std::size_t furthest() const noexcept {
+			return m_furthest;
+		}
+
+		// the first id to fail at the furthest position, no_expected before any failure
+		constexpr expected_id expected() const noexcept {
+			return m_id;
+		}
+
+		diagnostic take_diagnostic() {
+			std::sort(m_expected.begin(), m_expected.end());
+			return {m_furthest, std::move(m_expected)};
+		}
+	};
+
+	namespace detail {
+		template <typename C, typename It>
+		concept failure_sink = requires(C& ctx, It pos) {
+			ctx.fail(pos, expected_id{});
+		};
+	}
+
+	// names what P matches, failing with only id whatever error P had
+	template <typename P>
+	class expect_parser {
+	public:
+		using char_type = parser_char_t<P>;
+		using value_type = parser_value_t<P>;
+		using error_type = failure;
+		using parser_type = P;
+
+		static constexpr first_set first = first_set_v<P>;
+
+	private:
+		parser_type m_p;
+		expected_id m_id;
+
+	public:
+		explicit constexpr expect_parser(expected_id const id, parser_type p) :
+			m_p{std::move(p)},
+			m_id{id}
+		{}
+
+		constexpr expected_id id() const noexcept {
+			return m_id;
+		}
+
+		template <typename Self, typename It, typename S, typename... Cs>
+		requires concepts::same_as<std::remove_const_t<Self>, expect_parser> && (sizeof...(Cs) <= 1)
+		friend constexpr parser_result<char_type, value_type, error_type, It, S> tag_invoke(fb::tag_t<parse>, Self& p, It pos, S end, Cs&... ctx) {
+			auto b = parse(p.m_p, pos, end, ctx...);
+			auto r = parser_result<char_type, value_type, error_type, It, S>{default_result, pos};
+
+			if (b.index() == 1) {
+				r.set_value(std::move(b.value()), b.pos());
+				return r;
+			}
+
+			if constexpr((detail::failure_sink<Cs, It> && ...) && sizeof...(Cs) == 1) {
+				(ctx.fail(pos, p.m_id), ...);
+			}
+
+			r.set_error(failure{p.m_id}, pos);
+			return r;
+		}
+	};
+
+	template <typename P>
+	constexpr expect_parser<std::remove_cvref_t<P>> expect(expected_id const id, P&& p) {
+		return expect_parser<std::remove_cvref_t<P>>{id, std::forward<P>(p)};
+	}
+
+	/*
+		parses with a failure_context and, only if that fails, again in diagnostic mode to build
+		the error. the memo tables are reset in between, cached results would skip recording
+		what was expected.
+
+		a failing parse therefore costs two full passes from begin, and the second can't stop
+		early at the furthest failure: a parser that matched there by reading beyond it would
+		fail on a cut short input and add ids that were never expected. a successful parse,
+		or one where nothing named failed, costs one.
+	*/
+	template <typename P, std::random_access_iterator It, typename S>
+	parser_result<parser_char_t<P>, parser_value_t<P>, diagnostic, It, S> parse_with_diagnostics(P& p, It const begin, S const end, std::pmr::memory_resource* const resource = std::pmr::get_default_resource()) {
+		auto r = parser_result<parser_char_t<P>, parser_value_t<P>, diagnostic, It, S>{default_result, begin};
+		auto ctx = failure_context<It>{begin, resource};
+		auto fast = parse(p, begin, end, ctx);
+
+		if (fast.index() == 1) {
+			r.set_value(std::move(fast.value()), fast.pos());
+			return r;
+		}
+
+		// nothing named failed, the parser's own position is the best there is
+		if (ctx.expected() == no_expected) {
+			r.set_error(diagnostic{static_cast<std::size_t>(fast.pos() - begin), {}}, fast.pos());
+			return r;
+		}
+
+		ctx.diagnose();
+		parse(p, begin, end, ctx);
+
+		auto const offset = ctx.furthest();
+		r.set_error(ctx.take_diagnostic(), begin + static_cast<std::iter_difference_t<It>>(offset));
+		return r;
+	}
+}
+
+#endif
@@ -0,0 +1,144 @@
+#ifndef FB_COMBY_FIRST_SET_HPP
+#define FB_COMBY_FIRST_SET_HPP
+#include <cstddef>
+#include <cstdint>
+#include <array>
+#include <string_view>
+#include <type_traits>
+#include <utility>
+#include "fb/tag_invoke.hpp"
+#include "fb/comby/concepts.hpp"
+#include "fb/comby/parser.hpp"
+
+namespace fb::comby {
+	/*
+		the characters a parser can start a match with. characters up to 0xFF are kept in a
+		bitmap, anything wider only as a single flag. a nullable parser can also succeed
+		without consuming anything, so it has to be tried whatever comes next.
+	*/
+	struct first_set {
+		std::array<std::uint64_t, 4> bytes{};
+		bool wide = false;
+		bool nullable = false;
+
+		static constexpr first_set any() noexcept {
+			return {{~std::uint64_t{}, ~std::uint64_t{}, ~std::uint64_t{}, ~std::uint64_t{}}, true, true};
+		}
+
+		static constexpr first_set empty_match() noexcept {
+			return {{}, false, true};
+		}
+
+		static constexpr first_set of(std::u32string_view const chars) noexcept {
+			auto set = first_set{};
+
+			for (auto const c : chars) {
+				set.add(c);
+			}
+
+			return set;
+		}
+
+		static constexpr first_set range(char32_t const lo, char32_t const hi) noexcept {
+			auto set = first_set{};
+
+			for (auto c = lo; c <= hi && c <= 0xFF; ++c) {
+				set.add(c);
+			}
+
+			set.wide = hi > 0xFF;
+			return set;
+		}
+
+		constexpr first_set& add(char32_t const c) noexcept {
+			if (c > 0xFF) {
+				wide = true;
+			} else {
+				bytes[c >> 6] |= std::uint64_t{1} << (c & 63);
+			}
+
+			return *this;
+		}
+
+		constexpr bool contains(char32_t const c) const noexcept {
+			return c > 0xFF ? wide : (bytes[c >> 6] >> (c & 63)) & 1;
+		}
+
+		// whether some lookahead lets both through
+		constexpr bool overlaps(first_set const& other) const noexcept {
+			if (nullable || other.nullable || (wide && other.wide)) {
+				return true;
+			}
+
+			for (auto i = std::size_t{}; i < bytes.size(); ++i) {
+				if (bytes[i] & other.bytes[i]) {
+					return true;
+				}
+			}
+
+			return false;
+		}
+
+		friend constexpr first_set operator|(first_set a, first_set const& b) noexcept {
+			for (auto i = std::size_t{}; i < a.bytes.size(); ++i) {
+				a.bytes[i] |= b.bytes[i];
+			}
+
+			a.wide = a.wide || b.wide;
+			a.nullable = a.nullable || b.nullable;
+			return a;
+		}
+
+		constexpr bool operator==(first_set const&) const noexcept = default;
+	};
+
+	namespace detail {
+		template <typename P>
+		concept has_first_set = requires {
+			{std::remove_cvref_t<P>::first} -> concepts::same_as<first_set const&>;
+		};
+	}
+
+	// P::first if it declares one, otherwise P could start with anything
+	template <typename P>
+	inline constexpr first_set first_set_v = []() {
+		if constexpr(detail::has_first_set<P>) {
+			return std::remove_cvref_t<P>::first;
+		} else {
+			return first_set::any();
+		}
+	}();
+
+	// declares the first set of a parser that can't work it out, such as a wrapped_parser
+	template <first_set Set, typename P>
+	class with_first_parser {
+	public:
+		using char_type = parser_char_t<P>;
+		using value_type = parser_value_t<P>;
+		using error_type = parser_error_t<P>;
+		using parser_type = P;
+
+		static constexpr first_set first = Set;
+
+	private:
+		parser_type m_p;
+
+	public:
+		explicit constexpr with_first_parser(parser_type p) :
+			m_p{std::move(p)}
+		{}
+
+		template <typename Self, typename It, typename S, typename... Cs>
+		requires concepts::same_as<std::remove_const_t<Self>, with_first_parser> && (sizeof...(Cs) <= 1)
+		friend constexpr auto tag_invoke(fb::tag_t<parse>, Self& p, It pos, S end, Cs&... ctx) {
+			return parse(p.m_p, pos, end, ctx...);
+		}
+	};
+
+	template <first_set Set, typename P>
+	constexpr with_first_parser<Set, std::remove_cvref_t<P>> with_first(P&& p) {
+		return with_first_parser<Set, std::remove_cvref_t<P>>{std::forward<P>(p)};
+	}
+}
+
+#endif
@@ -0,0 +1,167 @@
+#ifndef FB_COMBY_LINE_INDEX_HPP
+#define FB_COMBY_LINE_INDEX_HPP
+#include <cstddef>
+#include <algorithm>
+#include <array>
+#include <iterator>
+#include <memory>
+#include <mutex>
+#include <span>
+#include <vector>
+#include "fb/comby/encoding.hpp"
+#include "fb/comby/bit.hpp"
+#include "fb/comby/simd.hpp"
+
+namespace fb::comby {
+	// line and column count from 1, in lines and code points, offset from 0 in units
+	struct position {
+		std::size_t offset;
+		std::size_t line;
+		std::size_t column;
+
+		constexpr bool operator==(position const&) const noexcept = default;
+	};
+
+	namespace detail {
+		// '\n' as it is stored, byte swapped for an encoding of the other endianness
+		template <encoding::encoding E>
+		constexpr encoding::unit_t<E> newline_unit() noexcept {
+			auto const unit = static_cast<encoding::unit_t<E>>('\n');
+
+			if constexpr(sizeof(unit) > 1 && requires { E::endian; }) {
+				return bit::cond_bswap<E::endian>(unit);
+			} else {
+				return unit;
+			}
+		}
+
+		template <encoding::encoding E>
+		std::size_t count_newlines(encoding::unit_t<E> const* p, std::size_t const n) noexcept {
+			if constexpr(sizeof(encoding::unit_t<E>) == 1) {
+				return simd::count_byte(reinterpret_cast<unsigned char const*>(p), n, static_cast<unsigned char>(newline_unit<E>()));
+			} else {
+				return static_cast<std::size_t>(std::count(p, p + n, newline_unit<E>()));
+			}
+		}
+	}
+
+	/*
+		turns positions in an input of E's units into lines and columns, which parsers then
+		don't have to track as they go. the first lookup counts the newlines of the whole
+		input in bulk, keeping for every block of block_size units the count before it and
+		where the line running into it starts. a lookup after that counts and looks for its
+		line's start within its own block only, then decodes the columns of its line up to
+		the offset, which on a very long line is the part that grows with it.
+
+		the index can be shared, between threads too, for as long as the units it was built
+		over live.
+	*/
+	template <encoding::encoding E>
+	class line_index {
+	public:
+		using unit_type = encoding::unit_t<E>;
+
+		static constexpr std::size_t block_size = 4096;
+
+	private:
+		std::span<unit_type const> m_units;
+		// the newlines before a block and the offset its first line starts at
+		struct block {
+			std::size_t lines;
+			std::size_t line_start;
+		};
+
+		mutable std::vector<block> m_blocks;
+		mutable std::once_flag m_built;
+
+		void build() const {
+			m_blocks.reserve(m_units.size() / block_size + 1);
+
+			auto const* const begin = m_units.data();
+			auto lines = std::size_t{};
+			auto line_start = std::size_t{};
+
+			for (auto at = std::size_t{}; at < m_units.size(); at += block_size) {
+				auto const size = std::min(block_size, m_units.size() - at);
+				auto const n = detail::count_newlines<E>(begin + at, size);
+
+				m_blocks.push_back({lines, line_start});
+				lines += n;
+
+				if (n) {
+					auto const last = std::find(std::make_reverse_iterator(begin + at + size), std::make_reverse_iterator(begin + at), detail::newline_unit<E>());
+					line_start = static_cast<std::size_t>(last.base() - begin);
+				}
+			}
+
+			m_blocks.push_back({lines, line_start});
+		}
+
+		// code points in the units of a line, each unit that fails to decode counts as one
+		std::size_t columns(std::span<unit_type const> units) const noexcept {
+			auto state = encoding::state_t<E>{};
+			auto codes = std::array<encoding::code_t<E>, 256>{};
+			auto n = std::size_t{};
+
+			while (!units.empty()) {
+				auto const r = encoding::decode_all<E>(state, units, codes);
+
+				n += r.dst.size();
+				units = units.subspan(r.src.size());
+
+				if (r.code == encoding::result_code::NOT_ENOUGH_INPUT) {
+					break;
+				} else if (!r && r.code != encoding::result_code::NOT_ENOUGH_STORAGE) {
+					// src held only the units before the failing one, which is skipped here
+					state = {};
+					units = units.subspan(!units.empty());
+					++n;
+				}
+			}
+
+			return n;
+		}
+
+	public:
+		explicit line_index(std::span<unit_type const> const units) noexcept :
+			m_units{units}
+		{}
+
+		line_index(line_index const&) = delete;
+		line_index& operator=(line_index const&) = delete;
+
+		// offset is clamped to the end of the input
+		position at(std::size_t offset) const {
+			std::call_once(m_built, [this] { build(); });
+
+			offset = std::min(offset, m_units.size());
+
+			auto const* const begin = m_units.data();
+			auto const& b = m_blocks[offset / block_size];
+			auto const block = offset / block_size * block_size;
+			auto const line = b.lines + detail::count_newlines<E>(begin + block, offset - block);
+
+			// the line starts within the block, or where the block's first line does
+			auto const before = std::make_reverse_iterator(begin + offset);
+			auto const block_begin = std::make_reverse_iterator(begin + block);
+			auto const newline = std::find(before, block_begin, detail::newline_unit<E>());
+			auto const start = newline != block_begin ? newline.base() : begin + b.line_start;
+
+			return {offset, line + 1, columns({start, begin + offset}) + 1};
+		}
+
+		// pos is anything pointing into the units, such as a parser_result's pos()
+		template <std::contiguous_iterator It>
+		position at(It const pos) const {
+			return at(static_cast<std::size_t>(std::to_address(pos) - m_units.data()));
+		}
+
+		// how many lines the input has, one more than its newlines
+		std::size_t lines() const {
+			std::call_once(m_built, [this] { build(); });
+			return m_blocks.back().lines + 1;
+		}
+	};
+}
+
+#endif
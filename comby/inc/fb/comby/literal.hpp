@@ -0,0 +1,272 @@
+#ifndef FB_COMBY_LITERAL_HPP
+#define FB_COMBY_LITERAL_HPP
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <iterator>
+#include <memory>
+#include <string_view>
+#include <type_traits>
+#include <variant>
+#include "fb/tag_invoke.hpp"
+#include "fb/comby/concepts.hpp"
+#include "fb/comby/parser.hpp"
+#include "fb/comby/first_set.hpp"
+
+namespace fb::comby {
+	// a string literal usable as a template argument, literal<"if">
+	template <typename CharT, std::size_t N>
+	struct fixed_string {
+		using char_type = CharT;
+
+		CharT chars[N]{};
+
+		constexpr fixed_string(CharT const (&s)[N]) noexcept {
+			std::copy_n(s, N, chars);
+		}
+
+		static constexpr std::size_t size() noexcept {
+			return N - 1;
+		}
+
+		constexpr CharT operator[](std::size_t const i) const noexcept {
+			return chars[i];
+		}
+
+		constexpr std::basic_string_view<CharT> view() const noexcept {
+			return {chars, N - 1};
+		}
+	};
+
+	// matches S exactly, the value is a view of S and an error is reported where S started
+	template <fixed_string S, typename E = std::monostate>
+	class literal_parser {
+	public:
+		using char_type = typename decltype(S)::char_type;
+		using value_type = std::basic_string_view<char_type>;
+		using error_type = E;
+
+		static constexpr first_set first = S.size() ? first_set{}.add(static_cast<char32_t>(static_cast<std::make_unsigned_t<char_type>>(S[0])))
+		                                            : first_set::empty_match();
+
+		template <typename It, typename Se>
+		friend constexpr parser_result<char_type, value_type, error_type, It, Se> tag_invoke(fb::tag_t<parse>, literal_parser const&, It pos, Se end) {
+			auto r = parser_result<char_type, value_type, error_type, It, Se>{default_result, pos};
+			auto it = pos;
+
+			for (auto i = std::size_t{}; i < S.size(); ++i, ++it) {
+				if (it == end || *it != S[i]) {
+					r.set_error(error_type{}, pos);
+					return r;
+				}
+			}
+
+			r.set_value(S.view(), it);
+			return r;
+		}
+	};
+
+	template <fixed_string S, typename E = std::monostate>
+	inline constexpr literal_parser<S, E> literal = {};
+
+	namespace detail {
+		/*
+			a trie of literals with nodes numbered in preorder, so a path without branches is a
+			run of consecutive nodes whose labels can be compared all at once. the root's
+			children are also indexed by byte.
+		*/
+		template <typename CharT, std::size_t Nodes>
+		struct literal_trie {
+			std::array<CharT, Nodes + 8> label{};
+			std::array<std::uint32_t, Nodes> accept{};
+			std::array<std::uint32_t, Nodes> next_sibling{};
+			std::array<std::uint32_t, Nodes> chain{};
+			std::array<bool, Nodes> has_child{};
+			std::array<std::uint32_t, 256> root{};
+			std::uint32_t size = 0;
+		};
+
+		template <typename CharT, std::size_t Nodes, std::size_t N>
+		constexpr literal_trie<CharT, Nodes> build_literal_trie(std::array<std::basic_string_view<CharT>, N> const& literals) {
+			auto trie = literal_trie<CharT, Nodes>{};
+			auto order = std::array<std::uint32_t, N>{};
+
+			for (auto i = std::uint32_t{}; i < N; ++i) {
+				order[i] = i;
+			}
+
+			std::sort(order.begin(), order.end(), [&](auto const a, auto const b) {
+				return literals[a] < literals[b] || (literals[a] == literals[b] && a < b);
+			});
+
+			// the literals order[lo, hi) share their first depth characters
+			auto const build = [&](auto const& self, std::size_t lo, std::size_t const hi, std::size_t const depth) -> std::uint32_t {
+				auto const id = trie.size++;
+
+				// equal literals sort by index, the first one wins
+				if (literals[order[lo]].size() == depth) {
+					trie.accept[id] = order[lo] + 1;
+
+					for (; lo < hi && literals[order[lo]].size() == depth; ++lo) {}
+				}
+
+				auto previous = std::uint32_t{};
+
+				while (lo < hi) {
+					auto const c = literals[order[lo]][depth];
+					auto group = lo;
+
+					for (; group < hi && literals[order[group]][depth] == c; ++group) {}
+
+					auto const child = self(self, lo, group, depth + 1);
+					trie.label[child] = c;
+					trie.has_child[id] = true;
+
+					if (previous) {
+						trie.next_sibling[previous] = child;
+					}
+
+					previous = child;
+					lo = group;
+				}
+
+				return id;
+			};
+
+			build(build, 0, N, 0);
+
+			for (auto n = trie.size; n-- > 0;) {
+				if (trie.has_child[n] && !trie.next_sibling[n + 1]) {
+					auto const next = trie.accept[n + 1] || !trie.chain[n + 1] ? 0 : trie.chain[n + 1];
+					trie.chain[n] = 1 + next;
+				}
+			}
+
+			for (auto child = trie.has_child[0] ? 1u : 0u; child; child = trie.next_sibling[child]) {
+				auto const c = static_cast<std::make_unsigned_t<CharT>>(trie.label[child]);
+
+				if (c < 256) {
+					trie.root[c] = child;
+				}
+			}
+
+			return trie;
+		}
+
+		// whether the n units from it on equal label, short runs of bytes are one word compare
+		template <typename CharT, typename It, typename S>
+		constexpr bool match_run(It const it, S const end, CharT const* label, std::size_t const n) {
+			if constexpr(std::contiguous_iterator<It> && std::sized_sentinel_for<S, It> && sizeof(CharT) == 1) {
+				if (!std::is_constant_evaluated()) {
+					auto const left = static_cast<std::size_t>(end - it);
+					auto const* p = std::to_address(it);
+
+					if (left < n) {
+						return false;
+					} else if (n <= 8 && left >= 8) {
+						auto a = std::uint64_t{};
+						auto b = std::uint64_t{};
+
+						std::memcpy(&a, p, 8);
+						std::memcpy(&b, label, 8);
+
+						// the first n bytes in memory, whichever end of the word that is
+						auto mask = ~std::uint64_t{};
+
+						if (n < 8) {
+							mask = std::endian::native == std::endian::little ? (std::uint64_t{1} << (n * 8)) - 1 : ~(mask >> (n * 8));
+						}
+
+						return !((a ^ b) & mask);
+					} else {
+						return !std::memcmp(p, label, n);
+					}
+				}
+			}
+
+			auto at = it;
+
+			for (auto i = std::size_t{}; i < n; ++i, ++at) {
+				if (at == end || *at != label[i]) {
+					return false;
+				}
+			}
+
+			return true;
+		}
+	}
+
+	/*
+		the longest of Ss that the input starts with, in one pass through a trie built at compile
+		time. the value is the index of the literal in Ss, the first one if it appears twice.
+	*/
+	template <typename E, fixed_string S, fixed_string... Ss>
+	requires (concepts::same_as<typename decltype(S)::char_type, typename decltype(Ss)::char_type> && ...)
+	class literals_parser {
+	public:
+		using char_type = typename decltype(S)::char_type;
+		using value_type = std::size_t;
+		using error_type = E;
+
+		static constexpr std::size_t size = sizeof...(Ss) + 1;
+		static constexpr first_set first = (literal_parser<S>::first | ... | literal_parser<Ss>::first);
+
+	private:
+		static constexpr auto trie = detail::build_literal_trie<char_type, 1 + S.size() + (Ss.size() + ... + 0)>(
+			std::array<std::basic_string_view<char_type>, size>{S.view(), Ss.view()...});
+
+	public:
+		template <typename It, typename Se>
+		friend constexpr parser_result<char_type, value_type, error_type, It, Se> tag_invoke(fb::tag_t<parse>, literals_parser const&, It pos, Se end) {
+			auto r = parser_result<char_type, value_type, error_type, It, Se>{default_result, pos};
+			auto node = std::uint32_t{};
+			auto it = pos;
+
+			while (true) {
+				if (trie.accept[node]) {
+					r.set_value(trie.accept[node] - 1, it);
+				}
+
+				if (auto const k = trie.chain[node]; k >= 2) {
+					if (!detail::match_run(it, end, trie.label.data() + node + 1, k)) {
+						break;
+					}
+
+					std::advance(it, k);
+					node += k;
+					continue;
+				}
+
+				if (!trie.has_child[node] || it == end) {
+					break;
+				}
+
+				auto const c = *it;
+				auto child = std::uint32_t{};
+
+				if (auto const u = static_cast<std::make_unsigned_t<char_type>>(c); node == 0 && u < 256) {
+					child = trie.root[u];
+				} else {
+					for (child = node + 1; child && trie.label[child] != c; child = trie.next_sibling[child]) {}
+				}
+
+				if (!child) {
+					break;
+				}
+
+				node = child;
+				++it;
+			}
+
+			return r;
+		}
+	};
+
+	template <fixed_string S, fixed_string... Ss>
+	inline constexpr literals_parser<std::monostate, S, Ss...> one_of_literals = {};
+}
+
+#endif
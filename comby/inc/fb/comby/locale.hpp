@@ -1,15 +1,21 @@
 #ifndef FB_COMBY_ENCODING_LOCALE_HPP
 #define FB_COMBY_ENCODING_LOCALE_HPP
 #include <cstddef>
+#include <cstdint>
 #include <cstdlib>
 #include <cuchar>
 #ifndef __STDC_UTF_32__
 #error "mbrtoc32() & c32rtomb() must use UTF-32"
 #endif
+#include <algorithm>
+#include <array>
 #include <memory>
 #include <exception>
 #include <span>
+#include <utility>
 #include "fb/comby/encoding.hpp"
+#include "fb/comby/simd.hpp"
+#include "fb/comby/utf8.hpp"
 
 namespace fb::comby::encoding {
 	// corosponds to the current C/C++ locale
@@ -51,14 +57,254 @@ namespace fb::comby::encoding {
 			auto ret = std::mbrtoc32(dst.data(), src.data(), src.size(), std::addressof(state));
 
 			switch(ret) {
-				case static_cast<std::size_t>(0): return {result_code::OK};
+				case static_cast<std::size_t>(0): return {result_code::OK, src.subspan(0, 1), dst.subspan(0, 1)};
 				case static_cast<std::size_t>(-1): return {result_code::INVALID_ENCODING, src};
-				case static_cast<std::size_t>(-2): std::terminate(); // not enough space, see encoding.hpp
+				case static_cast<std::size_t>(-2): return {result_code::NOT_ENOUGH_INPUT, src}; // kept in the mbstate_t
 				case static_cast<std::size_t>(-3): std::terminate(); // multi code point, not possible in UTF-32
 				default: return {result_code::OK, src.subspan(0, ret), dst.subspan(0, 1)};
 			}
 		}
 	};
+
+	// how cached_locale converts, see cached_locale::codeset
+	enum class codeset : std::uint8_t {
+		UTF_8,
+		SINGLE_BYTE, // ASCII, C, ISO-8859-x and the like, through a table
+		MULTI_BYTE // anything else, through mbrtoc32() & c32rtomb()
+	};
+
+	namespace detail {
+		struct codeset_info {
+			static constexpr char32_t unmapped = 0xFFFFFFFFu;
+
+			codeset kind = codeset::MULTI_BYTE;
+			std::array<char32_t, 256> to_code{};
+			std::array<std::pair<char32_t, unsigned char>, 128> from_code{}; // sorted, bytes >= 0x80 only
+			std::size_t from_code_size = 0;
+		};
+
+		template <typename To, typename R>
+		constexpr To rebind_result(R const& r) noexcept {
+			return {r.code, r.src, r.dst};
+		}
+
+		// asks libc what each byte, and a few UTF-8 sequences, decode to in the current locale
+		inline codeset_info detect_codeset() noexcept {
+			auto info = codeset_info{};
+			auto const decode = [](std::span<char const> units, char32_t& code) {
+				auto state = std::mbstate_t{};
+				return std::mbrtoc32(std::addressof(code), units.data(), units.size(), std::addressof(state));
+			};
+
+			if (MB_CUR_MAX == 1) {
+				for (auto i = std::size_t{}; i < info.to_code.size(); ++i) {
+					auto const unit = static_cast<char>(i);
+					auto code = char32_t{};
+					auto const ret = decode(std::span{&unit, 1}, code);
+
+					info.to_code[i] = ret <= 1 ? code : codeset_info::unmapped;
+
+					// the table is only used when ASCII maps to itself, which rules out EBCDIC
+					if (i < 0x80 && info.to_code[i] != i) {
+						return {};
+					} else if (i >= 0x80 && ret <= 1) {
+						info.from_code[info.from_code_size++] = {code, static_cast<unsigned char>(i)};
+					}
+				}
+
+				std::ranges::sort(std::span{info.from_code}.first(info.from_code_size));
+				info.kind = codeset::SINGLE_BYTE;
+			} else {
+				static constexpr auto samples = std::array<std::pair<std::string_view, char32_t>, 4>{{
+					{"\xC3\xA9", 0xE9u},
+					{"\xE2\x82\xAC", 0x20ACu},
+					{"\xF0\x9F\x98\x80", 0x1F600u},
+					{"\x80", 0}
+				}};
+
+				auto const is_utf8 = std::ranges::all_of(samples, [&](auto const& sample) {
+					auto code = char32_t{};
+					auto const ret = decode(sample.first, code);
+
+					return sample.second ? ret == sample.first.size() && code == sample.second
+					                     : ret == static_cast<std::size_t>(-1);
+				});
+
+				if (is_utf8) {
+					info.kind = codeset::UTF_8;
+				}
+			}
+
+			return info;
+		}
+
+		inline codeset_info& cached_codeset() noexcept {
+			static auto info = detect_codeset();
+			return info;
+		}
+	}
+
+	/*
+		the current C/C++ locale like locale, but the codeset is looked up once. UTF-8 locales
+		are handed to base_utf8 and single byte ones to a 256 entry table, both a whole
+		buffer at a time, leaving libc's per character conversion to the stateful multibyte
+		codesets. call reload() after changing the locale with setlocale(), it isn't thread
+		safe for the same reasons.
+	*/
+	struct cached_locale {
+		using unit_type = char;
+		using code_type = char32_t;
+
+		struct state_type {
+			std::mbstate_t mb{};
+			state_t<utf8_compat> utf8{};
+		};
+
+		static constexpr std::size_t max_units = MB_LEN_MAX;
+		static constexpr std::size_t max_codes = 1;
+
+		static codeset kind() noexcept {
+			return detail::cached_codeset().kind;
+		}
+
+		static void reload() noexcept {
+			detail::cached_codeset() = detail::detect_codeset();
+		}
+
+		static encode_result<cached_locale> encode(state_type& state,
+							   std::span<code_type const> src,
+							   std::span<unit_type> dst) noexcept
+		{
+			auto const& info = detail::cached_codeset();
+
+			switch (info.kind) {
+				case codeset::UTF_8: return detail::rebind_result<encode_result<cached_locale>>(utf8_compat::encode(state.utf8, src, dst));
+				case codeset::SINGLE_BYTE: break;
+				default: return detail::rebind_result<encode_result<cached_locale>>(locale::encode(state.mb, src, dst));
+			}
+
+			if (src.empty()) {
+				return {result_code::OK};
+			}
+
+			auto const unit = encode_single_byte(info, src[0]);
+
+			if (unit < 0) {
+				return {result_code::INVALID_CODE_POINT, src.subspan(0, 1)};
+			}
+
+			dst[0] = static_cast<unit_type>(unit);
+			return {result_code::OK, src.subspan(0, 1), dst.subspan(0, 1)};
+		}
+
+		static decode_result<cached_locale> decode(state_type& state,
+							   std::span<unit_type const> src,
+							   std::span<code_type> dst) noexcept
+		{
+			auto const& info = detail::cached_codeset();
+
+			switch (info.kind) {
+				case codeset::UTF_8: return detail::rebind_result<decode_result<cached_locale>>(utf8_compat::decode(state.utf8, src, dst));
+				case codeset::SINGLE_BYTE: break;
+				default: return detail::rebind_result<decode_result<cached_locale>>(locale::decode(state.mb, src, dst));
+			}
+
+			if (src.empty()) {
+				return {result_code::OK};
+			}
+
+			auto const code = info.to_code[static_cast<unsigned char>(src[0])];
+
+			if (code == detail::codeset_info::unmapped) {
+				return {result_code::INVALID_ENCODING, src.subspan(0, 1)};
+			}
+
+			dst[0] = code;
+			return {result_code::OK, src.subspan(0, 1), dst.subspan(0, 1)};
+		}
+
+		static decode_result<cached_locale> decode_all(state_type& state,
+							       std::span<unit_type const> src,
+							       std::span<code_type> dst) noexcept
+		{
+			auto const& info = detail::cached_codeset();
+
+			switch (info.kind) {
+				case codeset::UTF_8: return detail::rebind_result<decode_result<cached_locale>>(utf8_compat::decode_all(state.utf8, src, dst));
+				case codeset::SINGLE_BYTE: break;
+				default: return detail::rebind_result<decode_result<cached_locale>>(detail::decode_each<locale>(state.mb, src, dst));
+			}
+
+			auto const* units = reinterpret_cast<unsigned char const*>(src.data());
+			auto src_pos = std::size_t{};
+			auto dst_pos = std::size_t{};
+
+			while (src_pos < src.size()) {
+				auto const k = simd::ascii_widen(units + src_pos, std::min(src.size() - src_pos, dst.size() - dst_pos), dst.data() + dst_pos);
+
+				src_pos += k;
+				dst_pos += k;
+
+				for (; src_pos < src.size() && units[src_pos] >= 0x80u; ++src_pos, ++dst_pos) {
+					auto const code = info.to_code[units[src_pos]];
+
+					if (code == detail::codeset_info::unmapped) {
+						return {result_code::INVALID_ENCODING, src.first(src_pos), dst.first(dst_pos)};
+					} else if (dst_pos == dst.size()) {
+						return {result_code::NOT_ENOUGH_STORAGE, src.first(src_pos), dst.first(dst_pos)};
+					}
+
+					dst[dst_pos] = code;
+				}
+
+				if (src_pos < src.size() && dst_pos == dst.size()) {
+					return {result_code::NOT_ENOUGH_STORAGE, src.first(src_pos), dst.first(dst_pos)};
+				}
+			}
+
+			return {result_code::OK, src.first(src_pos), dst.first(dst_pos)};
+		}
+
+		static encode_result<cached_locale> encode_all(state_type& state,
+							       std::span<code_type const> src,
+							       std::span<unit_type> dst) noexcept
+		{
+			auto const& info = detail::cached_codeset();
+
+			switch (info.kind) {
+				case codeset::UTF_8: return detail::rebind_result<encode_result<cached_locale>>(encoding::encode_all<utf8_compat>(state.utf8, src, dst));
+				case codeset::SINGLE_BYTE: break;
+				default: return detail::rebind_result<encode_result<cached_locale>>(detail::encode_each<locale>(state.mb, src, dst));
+			}
+
+			auto const n = std::min(src.size(), dst.size());
+
+			for (auto i = std::size_t{}; i < n; ++i) {
+				auto const unit = encode_single_byte(info, src[i]);
+
+				if (unit < 0) {
+					return {result_code::INVALID_CODE_POINT, src.first(i), dst.first(i)};
+				}
+
+				dst[i] = static_cast<unit_type>(unit);
+			}
+
+			return {n < src.size() ? result_code::NOT_ENOUGH_STORAGE : result_code::OK, src.first(n), dst.first(n)};
+		}
+
+	private:
+		// the byte cp is encoded as, or -1
+		static int encode_single_byte(detail::codeset_info const& info, code_type const cp) noexcept {
+			if (cp < 0x80u) {
+				return static_cast<int>(cp);
+			}
+
+			auto const table = std::span{info.from_code}.first(info.from_code_size);
+			auto const it = std::ranges::lower_bound(table, cp, {}, &std::pair<char32_t, unsigned char>::first);
+
+			return it != table.end() && it->first == cp ? it->second : -1;
+		}
+	};
 }
 
 #endif
@@ -0,0 +1,304 @@
+#ifndef FB_COMBY_MAPPED_FILE_HPP
+#define FB_COMBY_MAPPED_FILE_HPP
+#include <cerrno>
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <span>
+#include <string_view>
+#include <system_error>
+#include <utility>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace fb::comby {
+	enum class access_hint {
+		normal,
+		sequential,
+		random
+	};
+
+	struct map_options {
+		// passed to madvise for the whole mapping
+		access_hint hint = access_hint::sequential;
+
+		// MADV_WILLNEED, starts reading the whole file in ahead of the parse
+		bool prefetch = false;
+
+		// a file of at least huge_page_size bytes is mapped at a huge page boundary
+		bool huge_pages = true;
+	};
+
+	/*
+		a file as one contiguous, read-only buffer of CharT, whose pointers plug into parse and
+		the encodings as they are. a regular file is mapped rather than read, so nothing is
+		copied and the kernel pages it in as the parse goes.
+
+		anything that cannot be mapped, a pipe, a terminal or a file in /proc that reports no
+		size, is read to its end into anonymous memory instead. that needs the whole input in
+		memory, as a std::string would.
+
+		pages stay resident once touched until the kernel needs them back, so a grammar that
+		never backtracks past a point can discard() what lies before it and parse a file of
+		any size in bounded memory. a trailing partial unit is not part of the buffer.
+
+		a mapped file must not be truncated while it is parsed, touching a page past its new end
+		raises SIGBUS. system calls that fail throw std::system_error.
+	*/
+	template <typename CharT = char>
+	class mapped_file {
+	public:
+		using char_type = CharT;
+		using iterator = char_type const*;
+
+		static constexpr std::size_t huge_page_size = std::size_t{2} << 20;
+
+	private:
+		void* m_base = nullptr;
+		std::size_t m_length = 0;
+		std::size_t m_size = 0;
+		std::size_t m_discarded = 0;
+		bool m_mapped = false;
+
+		[[noreturn]] static void fail(char const* const what) {
+			throw std::system_error{errno, std::generic_category(), what};
+		}
+
+		static std::size_t page_size() noexcept {
+			return static_cast<std::size_t>(::sysconf(_SC_PAGESIZE));
+		}
+
+		static void advise(void* const p, std::size_t const n, map_options const& options) noexcept {
+			// hints only, a kernel that ignores them parses just the same
+			switch (options.hint) {
+			case access_hint::sequential:
+				::madvise(p, n, MADV_SEQUENTIAL);
+				break;
+			case access_hint::random:
+				::madvise(p, n, MADV_RANDOM);
+				break;
+			default:
+				break;
+			}
+
+			if (options.prefetch) {
+				::madvise(p, n, MADV_WILLNEED);
+			}
+#ifdef MADV_HUGEPAGE
+			if (options.huge_pages && n >= huge_page_size) {
+				::madvise(p, n, MADV_HUGEPAGE);
+			}
+#endif
+		}
+
+		void map(int const fd, std::size_t const size, map_options const& options) {
+			auto* hint = static_cast<void*>(nullptr);
+
+			// reserve a huge page more than needed and map the file over its aligned start
+			if (options.huge_pages && size >= huge_page_size) {
+				auto* const reserved = ::mmap(nullptr, size + huge_page_size, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+
+				if (reserved != MAP_FAILED) {
+					auto const at = reinterpret_cast<std::uintptr_t>(reserved);
+					auto const aligned = (at + huge_page_size - 1) & ~(huge_page_size - 1);
+
+					hint = reinterpret_cast<void*>(aligned);
+					::munmap(reserved, size + huge_page_size);
+				}
+			}
+
+			// the reservation is gone again, so the hint is only taken while nothing else claims it
+			m_base = ::mmap(hint, size, PROT_READ, MAP_PRIVATE, fd, 0);
+
+			if (m_base == MAP_FAILED) {
+				m_base = nullptr;
+				fail("mmap");
+			}
+
+			m_length = size;
+			m_size = size;
+			m_mapped = true;
+
+			advise(m_base, size, options);
+		}
+
+		void read_all(int const fd, map_options const& options) {
+			auto capacity = std::size_t{64} << 10;
+
+			m_base = ::mmap(nullptr, capacity, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+
+			if (m_base == MAP_FAILED) {
+				m_base = nullptr;
+				fail("mmap");
+			}
+
+			m_length = capacity;
+
+			while (true) {
+				if (m_size == capacity) {
+					auto* const grown = ::mremap(m_base, capacity, capacity * 2, MREMAP_MAYMOVE);
+
+					if (grown == MAP_FAILED) {
+						fail("mremap");
+					}
+
+					m_base = grown;
+					capacity *= 2;
+					m_length = capacity;
+				}
+
+				auto const n = ::read(fd, static_cast<std::byte*>(m_base) + m_size, capacity - m_size);
+
+				if (n > 0) {
+					m_size += static_cast<std::size_t>(n);
+				} else if (!n) {
+					break;
+				} else if (errno != EINTR) {
+					fail("read");
+				}
+			}
+
+			::mprotect(m_base, m_length, PROT_READ);
+			advise(m_base, m_length, options);
+		}
+
+		void open(int const fd, map_options const& options) {
+			struct stat st;
+
+			if (::fstat(fd, &st)) {
+				fail("fstat");
+			}
+
+			try {
+				if (S_ISREG(st.st_mode) && st.st_size > 0) {
+					map(fd, static_cast<std::size_t>(st.st_size), options);
+				} else {
+					read_all(fd, options);
+				}
+			} catch (...) {
+				close();
+				throw;
+			}
+		}
+
+		void close() noexcept {
+			if (m_base) {
+				::munmap(m_base, m_length);
+			}
+
+			m_base = nullptr;
+			m_length = 0;
+			m_size = 0;
+			m_discarded = 0;
+			m_mapped = false;
+		}
+
+	public:
+		mapped_file() = default;
+
+		explicit mapped_file(std::filesystem::path const& path, map_options const& options = {}) {
+			auto const fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+
+			if (fd < 0) {
+				fail("open");
+			}
+
+			try {
+				open(fd, options);
+			} catch (...) {
+				::close(fd);
+				throw;
+			}
+
+			// a mapping outlives the descriptor it was made from
+			::close(fd);
+		}
+
+		// maps or reads fd, which stays open and is not closed
+		explicit mapped_file(int const fd, map_options const& options = {}) {
+			open(fd, options);
+		}
+
+		mapped_file(mapped_file const&) = delete;
+		mapped_file& operator=(mapped_file const&) = delete;
+
+		mapped_file(mapped_file&& other) noexcept :
+			m_base{std::exchange(other.m_base, nullptr)},
+			m_length{std::exchange(other.m_length, 0)},
+			m_size{std::exchange(other.m_size, 0)},
+			m_discarded{std::exchange(other.m_discarded, 0)},
+			m_mapped{std::exchange(other.m_mapped, false)}
+		{}
+
+		mapped_file& operator=(mapped_file&& other) noexcept {
+			if (this != &other) {
+				close();
+				m_base = std::exchange(other.m_base, nullptr);
+				m_length = std::exchange(other.m_length, 0);
+				m_size = std::exchange(other.m_size, 0);
+				m_discarded = std::exchange(other.m_discarded, 0);
+				m_mapped = std::exchange(other.m_mapped, false);
+			}
+
+			return *this;
+		}
+
+		~mapped_file() {
+			close();
+		}
+
+		char_type const* data() const noexcept {
+			return static_cast<char_type const*>(m_base);
+		}
+
+		// in units of CharT
+		std::size_t size() const noexcept {
+			return m_size / sizeof(char_type);
+		}
+
+		bool empty() const noexcept {
+			return !size();
+		}
+
+		iterator begin() const noexcept {
+			return data();
+		}
+
+		iterator end() const noexcept {
+			return data() + size();
+		}
+
+		std::basic_string_view<char_type> view() const noexcept {
+			return {data(), size()};
+		}
+
+		std::span<char_type const> units() const noexcept {
+			return {data(), size()};
+		}
+
+		// whether the file is mapped, or was read because it could not be
+		bool mapped() const noexcept {
+			return m_mapped;
+		}
+
+		/*
+			gives back the pages wholly before pos, the parse must not look at them again. a
+			mapped page is only dropped from memory and would be read back from the file, read
+			input is lost for good.
+		*/
+		void discard(iterator const pos) noexcept {
+			auto const page = page_size();
+			auto const offset = static_cast<std::size_t>(reinterpret_cast<std::byte const*>(pos) - static_cast<std::byte const*>(m_base));
+			auto const n = offset / page * page;
+
+			if (n > m_discarded) {
+				::madvise(static_cast<std::byte*>(m_base) + m_discarded, n - m_discarded, MADV_DONTNEED);
+				m_discarded = n;
+			}
+		}
+	};
+}
+
+#endif
@@ -0,0 +1,224 @@
+#ifndef FB_COMBY_MEMO_HPP
+#define FB_COMBY_MEMO_HPP
+#include <cstddef>
+#include <algorithm>
+#include <atomic>
+#include <iterator>
+#include <limits>
+#include <memory>
+#include <memory_resource>
+#include <optional>
+#include <type_traits>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+#include "fb/tag_invoke.hpp"
+#include "fb/comby/concepts.hpp"
+#include "fb/comby/parser.hpp"
+#include "fb/comby/first_set.hpp"
+
+namespace fb::comby {
+	namespace detail {
+		// every memo() gets its own table in a memo_context, copies of one share it. ids are
+		// never reused, a context only holds tables for the ones it has parsed
+		inline std::atomic<std::size_t> next_memo_id = 0;
+
+		class memo_table_base {
+		public:
+			std::size_t hits = 0;
+			std::size_t misses = 0;
+
+			virtual ~memo_table_base() = default;
+			virtual void clear() noexcept = 0;
+		};
+
+		template <typename R>
+		class memo_table final : public memo_table_base {
+		private:
+			static constexpr auto no_pos = std::numeric_limits<std::size_t>::max();
+
+			struct entry {
+				std::size_t pos = no_pos;
+				std::optional<R> result;
+			};
+
+			std::size_t m_capacity;
+			std::vector<entry> m_entries;
+
+		public:
+			explicit memo_table(std::size_t const capacity) :
+				m_capacity{capacity},
+				m_entries(capacity)
+			{}
+
+			entry& slot(std::size_t const pos) {
+				if (m_capacity) {
+					return m_entries[pos % m_capacity];
+				} else if (pos >= m_entries.size()) {
+					m_entries.resize(std::max(pos + 1, m_entries.size() * 2));
+				}
+
+				return m_entries[pos];
+			}
+
+			void clear() noexcept override {
+				hits = 0;
+				misses = 0;
+
+				for (auto& e : m_entries) {
+					e.pos = no_pos;
+					e.result.reset();
+				}
+			}
+		};
+	}
+
+	/*
+		the memo tables of one parse, so that the grammar itself stays immutable and can be
+		shared. each thread parses with its own context, and reset() starts a new input while
+		keeping the tables' memory.
+
+		cached values built from this context's resource have to be reset() before that
+		resource is released.
+	*/
+	template <std::random_access_iterator It>
+	class memo_context : public parse_context {
+	public:
+		using iterator = It;
+
+	private:
+		iterator m_begin;
+		std::unordered_map<std::size_t, std::unique_ptr<detail::memo_table_base>> m_tables;
+
+	public:
+		explicit memo_context(iterator const begin, std::pmr::memory_resource* const resource = std::pmr::get_default_resource()) :
+			parse_context{resource},
+			m_begin{begin}
+		{}
+
+		// forgets every result and counts positions from begin
+		void reset(iterator const begin) noexcept {
+			m_begin = begin;
+
+			for (auto& [id, t] : m_tables) {
+				t->clear();
+			}
+		}
+
+		iterator begin() const noexcept {
+			return m_begin;
+		}
+
+		std::size_t offset(iterator const pos) const noexcept {
+			return static_cast<std::size_t>(pos - m_begin);
+		}
+
+		template <typename R>
+		detail::memo_table<R>& table(std::size_t const id, std::size_t const capacity) {
+			if (auto const it = m_tables.find(id); it != m_tables.end()) {
+				return static_cast<detail::memo_table<R>&>(*it->second);
+			}
+
+			auto t = std::make_unique<detail::memo_table<R>>(capacity);
+			auto& table = *t;
+
+			m_tables.emplace(id, std::move(t));
+			return table;
+		}
+
+		std::size_t hits() const noexcept {
+			auto n = std::size_t{};
+
+			for (auto const& [id, t] : m_tables) {
+				n += t->hits;
+			}
+
+			return n;
+		}
+
+		std::size_t misses() const noexcept {
+			auto n = std::size_t{};
+
+			for (auto const& [id, t] : m_tables) {
+				n += t->misses;
+			}
+
+			return n;
+		}
+	};
+
+	/*
+		packrat memoization of one rule. parsed with a memo_context, the result at a position is
+		kept in a flat table indexed by the distance from the start of the input, so parsing
+		there again is a copy instead of a re-run. only the rules wrapped with memo() pay for
+		this, and without a memo_context they are parsed as they are.
+
+		with a capacity the table is a ring of that many slots, a position evicting whatever
+		was stored capacity positions before it. backtracking further than that re-parses, but
+		memory stays bounded however large the input is. without one the table grows to the
+		furthest position seen.
+
+		left recursive rules still recurse forever, the table is only filled once a parse at a
+		position finishes.
+	*/
+	template <typename P, std::random_access_iterator It, typename S = It>
+	class memo_parser {
+	public:
+		using char_type = parser_char_t<P>;
+		using value_type = parser_value_t<P>;
+		using error_type = parser_error_t<P>;
+		using parser_type = P;
+		using iterator = It;
+		using sentinel = S;
+		using result_type = parser_result<char_type, value_type, error_type, iterator, sentinel>;
+
+		static constexpr first_set first = first_set_v<P>;
+
+	private:
+		parser_type m_p;
+		std::size_t m_id;
+		std::size_t m_capacity;
+
+	public:
+		// a capacity of 0 keeps every position
+		explicit memo_parser(parser_type p, std::size_t const capacity = 0) :
+			m_p{std::move(p)},
+			m_id{detail::next_memo_id.fetch_add(1, std::memory_order_relaxed)},
+			m_capacity{capacity}
+		{}
+
+		template <typename Self, typename... Cs>
+		requires concepts::same_as<std::remove_const_t<Self>, memo_parser> && (sizeof...(Cs) <= 1)
+		friend result_type tag_invoke(fb::tag_t<parse>, Self& p, iterator pos, sentinel end, Cs&... ctx) {
+			if constexpr(sizeof...(Cs) == 1 && (std::is_base_of_v<memo_context<iterator>, Cs> && ...)) {
+				auto& table = (ctx.template table<result_type>(p.m_id, p.m_capacity), ...);
+				auto const index = (ctx.offset(pos), ...);
+
+				if (auto& e = table.slot(index); e.pos == index) {
+					++table.hits;
+					return *e.result;
+				}
+
+				++table.misses;
+
+				// the slot is looked up again, parsing may have grown the table or reused the slot
+				auto r = parse(p.m_p, pos, end, ctx...);
+				auto& e = table.slot(index);
+
+				e.pos = index;
+				e.result.emplace(r);
+
+				return r;
+			} else {
+				return parse(p.m_p, pos, end, ctx...);
+			}
+		}
+	};
+
+	template <std::random_access_iterator It, typename S = It, typename P>
+	memo_parser<std::remove_cvref_t<P>, It, S> memo(P&& p, std::size_t const capacity = 0) {
+		return memo_parser<std::remove_cvref_t<P>, It, S>{std::forward<P>(p), capacity};
+	}
+}
+
+#endif
@@ -0,0 +1,57 @@
+#ifndef FB_COMBY_NAMED_HPP
+#define FB_COMBY_NAMED_HPP
+#include <string_view>
+#include <type_traits>
+#include <utility>
+#include "fb/tag_invoke.hpp"
+#include "fb/comby/concepts.hpp"
+#include "fb/comby/parser.hpp"
+#include "fb/comby/first_set.hpp"
+#include "fb/comby/profile.hpp"
+
+namespace fb::comby {
+	/*
+		P as a rule of its own in the profile, see profile.hpp. copies are the same rule. the
+		rule is registered and its id kept in every build, so the layout doesn't depend on
+		FB_COMBY_PROFILE; without it the parse CPO never reports and P is parsed straight
+		through.
+	*/
+	template <typename P>
+	class named_parser {
+	public:
+		using char_type = parser_char_t<P>;
+		using value_type = parser_value_t<P>;
+		using error_type = parser_error_t<P>;
+		using parser_type = P;
+
+		static constexpr first_set first = first_set_v<P>;
+
+	private:
+		parser_type m_p;
+		profile::rule_id m_rule;
+
+	public:
+		explicit named_parser(std::string_view const name, parser_type p) :
+			m_p{std::move(p)},
+			m_rule{profile::register_rule(name)}
+		{}
+
+		profile::rule_id profile_rule() const noexcept {
+			return m_rule;
+		}
+
+		template <typename Self, typename It, typename S, typename... Cs>
+		requires concepts::same_as<std::remove_const_t<Self>, named_parser> && (sizeof...(Cs) <= 1)
+		friend constexpr auto tag_invoke(fb::tag_t<parse>, Self& p, It pos, S end, Cs&... ctx) {
+			return parse(p.m_p, pos, end, ctx...);
+		}
+	};
+
+	// name has to outlive every profile report, a string literal does
+	template <typename P>
+	named_parser<std::remove_cvref_t<P>> named(std::string_view const name, P&& p) {
+		return named_parser<std::remove_cvref_t<P>>{name, std::forward<P>(p)};
+	}
+}
+
+#endif
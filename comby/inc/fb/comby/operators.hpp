@@ -0,0 +1,293 @@
+#ifndef FB_COMBY_OPERATORS_HPP
+#define FB_COMBY_OPERATORS_HPP
+#include <cstddef>
+#include <array>
+#include <functional>
+#include <string_view>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <variant>
+#include "fb/tag_invoke.hpp"
+#include "fb/comby/concepts.hpp"
+#include "fb/comby/parser.hpp"
+#include "fb/comby/first_set.hpp"
+#include "fb/comby/literal.hpp"
+
+namespace fb::comby {
+	enum class assoc {
+		left,
+		right
+	};
+
+	namespace detail {
+		enum class operator_kind {
+			prefix,
+			infix,
+			postfix
+		};
+
+		/*
+			an operator of a table, its token, precedence and associativity are part of its type
+			and only the function building its value is kept. a higher precedence binds tighter.
+		*/
+		template <operator_kind Kind, fixed_string Token, unsigned Precedence, assoc Assoc, typename F>
+		requires (Token.size() > 0) && (Precedence < 0x7FFFFFFFu)
+		struct operator_def {
+			static constexpr operator_kind kind = Kind;
+			static constexpr auto token = Token;
+			static constexpr unsigned precedence = Precedence;
+			static constexpr assoc associativity = Assoc;
+
+			// how tightly it holds the operand on its left, and the weakest operator the
+			// operand on its right may contain
+			static constexpr unsigned left_power = 2 * Precedence + (Assoc == assoc::right);
+			static constexpr unsigned right_power = 2 * Precedence + 1;
+
+			F f;
+		};
+
+		template <typename Op, typename V>
+		concept operator_for =
+			(Op::kind == operator_kind::infix && std::is_invocable_r_v<V, decltype(Op::f) const&, V, V>)
+			|| (Op::kind != operator_kind::infix && std::is_invocable_r_v<V, decltype(Op::f) const&, V>);
+
+		// the indices of Ops that are read where an operand is expected, or after one
+		template <bool Operand, typename... Ops>
+		struct operator_indices {
+			static constexpr auto kinds = std::array<operator_kind, sizeof...(Ops)>{Ops::kind...};
+
+			static constexpr std::size_t size = []() {
+				auto n = std::size_t{};
+
+				for (auto const k : kinds) {
+					n += (k == operator_kind::prefix) == Operand;
+				}
+
+				return n;
+			}();
+
+			static constexpr auto indices = []() {
+				auto out = std::array<std::size_t, size>{};
+				auto n = std::size_t{};
+
+				for (auto i = std::size_t{}; i < kinds.size(); ++i) {
+					if ((kinds[i] == operator_kind::prefix) == Operand) {
+						out[n++] = i;
+					}
+				}
+
+				return out;
+			}();
+
+			template <std::size_t... Is>
+			static std::index_sequence<indices[Is]...> select(std::index_sequence<Is...>);
+
+			using type = decltype(select(std::make_index_sequence<size>()));
+		};
+
+		template <typename Ops, typename Is>
+		struct operator_tokens {
+			static constexpr bool distinct = true;
+			static constexpr first_set first = first_set{};
+		};
+
+		template <typename... Ops, std::size_t I, std::size_t... Is>
+		struct operator_tokens<std::tuple<Ops...>, std::index_sequence<I, Is...>> {
+			template <std::size_t J>
+			using op = std::tuple_element_t<J, std::tuple<Ops...>>;
+
+			using type = literals_parser<std::monostate, op<I>::token, op<Is>::token...>;
+
+			static constexpr auto indices = std::array<std::size_t, sizeof...(Is) + 1>{I, Is...};
+			static constexpr first_set first = type::first;
+
+			static constexpr bool distinct = []() {
+				auto const views = std::array{op<I>::token.view(), op<Is>::token.view()...};
+
+				for (auto i = std::size_t{}; i < views.size(); ++i) {
+					for (auto j = i + 1; j < views.size(); ++j) {
+						if (views[i] == views[j]) {
+							return false;
+						}
+					}
+				}
+
+				return true;
+			}();
+		};
+	}
+
+	// -x, parsed with an operand holding only operators of a higher precedence
+	template <fixed_string Token, unsigned Precedence, typename F>
+	constexpr detail::operator_def<detail::operator_kind::prefix, Token, Precedence, assoc::right, std::remove_cvref_t<F>> prefix(F&& f) {
+		return {std::forward<F>(f)};
+	}
+
+	// x + y, called with the values of both operands
+	template <fixed_string Token, unsigned Precedence, assoc Assoc = assoc::left, typename F>
+	constexpr detail::operator_def<detail::operator_kind::infix, Token, Precedence, Assoc, std::remove_cvref_t<F>> infix(F&& f) {
+		return {std::forward<F>(f)};
+	}
+
+	// x!, applied to everything on its left that binds at least as tightly
+	template <fixed_string Token, unsigned Precedence, typename F>
+	constexpr detail::operator_def<detail::operator_kind::postfix, Token, Precedence, assoc::left, std::remove_cvref_t<F>> postfix(F&& f) {
+		return {std::forward<F>(f)};
+	}
+
+	/*
+		an expression of P's operands joined by a table of operators, parsed in one Pratt
+		loop instead of a rule per precedence level. after each operand the operator that
+		follows is read once and either taken, when it binds at least as tightly as the
+		caller allows, or left to the caller. every operand and operator costs a bounded
+		number of calls however many levels the table has, and only operators whose right
+		operand binds tighter nest a call: right associative chains and runs of prefixes.
+
+		tokens are read where an operand is expected for prefixes, and after an operand for
+		infixes and postfixes, so "-" can be both a prefix and an infix. within each of those
+		two sets the longest token wins, as in one_of_literals, and each token appears once.
+		operators sharing a precedence should share an associativity too. a prefix applies to
+		its operand together with any tighter operators, so with "-" below "^", -2^2 is -4.
+
+		nothing is skipped between tokens, a P that eats the whitespace around its operands
+		lets the operators be spaced out. a parenthesised operand is P's to parse, usually by
+		referring back to the expression. a token that isn't followed by an operand fails the
+		expression with P's error, rather than backtracking to before it.
+	*/
+	template <typename P, typename... Ops>
+	requires (detail::operator_for<Ops, parser_value_t<P>> && ...)
+	      && (concepts::same_as<parser_char_t<P>, typename decltype(Ops::token)::char_type> && ...)
+	class operator_parser {
+	public:
+		using char_type = parser_char_t<P>;
+		using value_type = parser_value_t<P>;
+		using error_type = parser_error_t<P>;
+		using parser_type = P;
+
+	private:
+		using operators = std::tuple<Ops...>;
+		using prefixes = detail::operator_tokens<operators, typename detail::operator_indices<true, Ops...>::type>;
+		using suffixes = detail::operator_tokens<operators, typename detail::operator_indices<false, Ops...>::type>;
+
+		static_assert(prefixes::distinct && suffixes::distinct, "a token appears twice among prefixes or among infix and postfix operators");
+
+	public:
+		static constexpr first_set first = first_set_v<P> | prefixes::first;
+
+	private:
+		parser_type m_p;
+		operators m_ops;
+
+		template <typename It, typename S>
+		using result_type = parser_result<char_type, value_type, error_type, It, S>;
+
+		template <std::size_t I>
+		using op = std::tuple_element_t<I, operators>;
+
+		template <std::size_t I, typename Self, typename It, typename S, typename... Cs>
+		static constexpr result_type<It, S> apply_prefix(Self& p, It const pos, S const end, Cs&... ctx) {
+			auto r = expression(p, pos, end, op<I>::right_power, ctx...);
+
+			if (r.has_value()) {
+				auto v = value_type(std::invoke(std::get<I>(p.m_ops).f, std::move(r.value())));
+				r.set_value(std::move(v), r.pos());
+			}
+
+			return r;
+		}
+
+		// extends lhs by the operator read up to pos, false when it binds too loosely or fails
+		template <std::size_t I, typename Self, typename It, typename S, typename... Cs>
+		static constexpr bool apply_suffix(Self& p, result_type<It, S>& lhs, It const pos, S const end, unsigned const power, Cs&... ctx) {
+			if (op<I>::left_power < power) {
+				return false;
+			}
+
+			if constexpr(op<I>::kind == detail::operator_kind::postfix) {
+				auto v = value_type(std::invoke(std::get<I>(p.m_ops).f, std::move(lhs.value())));
+				lhs.set_value(std::move(v), pos);
+				return true;
+			} else {
+				auto rhs = expression(p, pos, end, op<I>::right_power, ctx...);
+
+				if (!rhs.has_value()) {
+					lhs.set_error(std::move(rhs.error()), rhs.pos());
+					return false;
+				}
+
+				auto v = value_type(std::invoke(std::get<I>(p.m_ops).f, std::move(lhs.value()), std::move(rhs.value())));
+				lhs.set_value(std::move(v), rhs.pos());
+				return true;
+			}
+		}
+
+		// one entry per token of a set, indexed by the value of its literals_parser
+		template <typename Self, typename It, typename S, typename... Cs>
+		static constexpr auto prefix_table = []<std::size_t... Is>(std::index_sequence<Is...>) {
+			return std::array{&apply_prefix<prefixes::indices[Is], Self, It, S, Cs...>...};
+		}(std::make_index_sequence<prefixes::indices.size()>());
+
+		template <typename Self, typename It, typename S, typename... Cs>
+		static constexpr auto suffix_table = []<std::size_t... Is>(std::index_sequence<Is...>) {
+			return std::array{&apply_suffix<suffixes::indices[Is], Self, It, S, Cs...>...};
+		}(std::make_index_sequence<suffixes::indices.size()>());
+
+		// an operand, then every operator after it binding at least as tightly as power
+		template <typename Self, typename It, typename S, typename... Cs>
+		static constexpr result_type<It, S> expression(Self& p, It const pos, S const end, unsigned const power, Cs&... ctx) {
+			auto r = result_type<It, S>{default_result, pos};
+			auto prefixed = false;
+
+			if constexpr(requires { typename prefixes::type; }) {
+				if (auto const t = parse(typename prefixes::type{}, pos, end); t.has_value()) {
+					r = prefix_table<Self, It, S, Cs...>[t.value()](p, t.pos(), end, ctx...);
+					prefixed = true;
+				}
+			}
+
+			if (!prefixed) {
+				auto a = parse(p.m_p, pos, end, ctx...);
+
+				if (!a.has_value()) {
+					r.set_error(std::move(a.error()), a.pos());
+					return r;
+				}
+
+				r.set_value(std::move(a.value()), a.pos());
+			}
+
+			if constexpr(requires { typename suffixes::type; }) {
+				while (r.has_value()) {
+					auto const t = parse(typename suffixes::type{}, r.pos(), end);
+
+					if (!t.has_value() || !suffix_table<Self, It, S, Cs...>[t.value()](p, r, t.pos(), end, power, ctx...)) {
+						break;
+					}
+				}
+			}
+
+			return r;
+		}
+
+	public:
+		explicit constexpr operator_parser(parser_type p, Ops... ops) :
+			m_p{std::move(p)},
+			m_ops{std::move(ops)...}
+		{}
+
+		// with or without a context, which is passed on to every operand
+		template <typename Self, typename It, typename S, typename... Cs>
+		requires concepts::same_as<std::remove_const_t<Self>, operator_parser> && (sizeof...(Cs) <= 1)
+		friend constexpr result_type<It, S> tag_invoke(fb::tag_t<parse>, Self& p, It pos, S end, Cs&... ctx) {
+			return expression(p, pos, end, 0, ctx...);
+		}
+	};
+
+	template <typename P, typename... Ops>
+	constexpr operator_parser<std::remove_cvref_t<P>, std::remove_cvref_t<Ops>...> operators(P&& p, Ops&&... ops) {
+		return operator_parser<std::remove_cvref_t<P>, std::remove_cvref_t<Ops>...>{std::forward<P>(p), std::forward<Ops>(ops)...};
+	}
+}
+
+#endif
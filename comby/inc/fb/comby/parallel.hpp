@@ -0,0 +1,284 @@
+#ifndef FB_COMBY_PARALLEL_HPP
+#define FB_COMBY_PARALLEL_HPP
+#include <cstddef>
+#include <cstring>
+#include <algorithm>
+#include <atomic>
+#include <exception>
+#include <iterator>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+#include "fb/tag_invoke.hpp"
+#include "fb/comby/concepts.hpp"
+#include "fb/comby/parser.hpp"
+
+namespace fb::comby {
+	/*
+		records ending in delimiter, a split finds the first record boundary at or after from,
+		which is just past the next delimiter or end. a buffer of bytes is searched by memchr.
+
+		any callable of the same shape splits other formats, a length prefixed stream by
+		walking the prefixes from the start of the buffer for instance.
+	*/
+	template <typename CharT = char>
+	struct delimited {
+		CharT delimiter = '\n';
+
+		template <std::random_access_iterator It>
+		constexpr It operator()(It const from, It const end) const {
+			if constexpr(std::contiguous_iterator<It> && sizeof(std::iter_value_t<It>) == 1) {
+				if (!std::is_constant_evaluated()) {
+					auto const n = static_cast<std::size_t>(end - from);
+					auto const* hit = static_cast<std::byte const*>(std::memchr(std::to_address(from), static_cast<unsigned char>(delimiter), n));
+
+					return hit ? from + (hit - reinterpret_cast<std::byte const*>(std::to_address(from)) + 1) : end;
+				}
+			}
+
+			auto const it = std::find(from, end, delimiter);
+			return it == end ? end : std::next(it);
+		}
+	};
+
+	template <typename CharT>
+	delimited(CharT) -> delimited<CharT>;
+
+	struct record_options {
+		// 0 for one per hardware thread
+		std::size_t threads = 0;
+
+		// about how many units each chunk holds, it is cut at the next record boundary
+		std::size_t chunk_size = std::size_t{1} << 20;
+	};
+
+	template <typename V, typename E>
+	struct records {
+		// every record before the first error, in input order
+		std::vector<V> values;
+		std::optional<record_error<E>> error;
+	};
+
+	namespace detail {
+		/*
+			chunk indices dealt out to the workers in contiguous runs. a worker takes from the
+			front of its own run and, once that is empty, steals the back half of another's, so
+			chunks that parse slowly don't leave the other threads idle.
+		*/
+		class chunk_queue {
+		private:
+			struct run {
+				std::mutex lock;
+				std::size_t next = 0;
+				std::size_t last = 0;
+			};
+
+			std::unique_ptr<run[]> m_runs;
+			std::size_t m_workers;
+
+		public:
+			chunk_queue(std::size_t const chunks, std::size_t const workers) :
+				m_runs{std::make_unique<run[]>(workers)},
+				m_workers{workers}
+			{
+				for (auto i = std::size_t{}; i < workers; ++i) {
+					m_runs[i].next = chunks * i / workers;
+					m_runs[i].last = chunks * (i + 1) / workers;
+				}
+			}
+
+			std::optional<std::size_t> pop(std::size_t const worker) {
+				auto& own = m_runs[worker];
+
+				{
+					auto const guard = std::lock_guard{own.lock};
+
+					if (own.next != own.last) {
+						return own.next++;
+					}
+				}
+
+				for (auto i = std::size_t{1}; i < m_workers; ++i) {
+					auto& victim = m_runs[(worker + i) % m_workers];
+					auto first = std::size_t{};
+					auto last = std::size_t{};
+
+					{
+						auto const guard = std::lock_guard{victim.lock};
+						auto const left = victim.last - victim.next;
+
+						if (!left) {
+							continue;
+						}
+
+						first = victim.last - (left + 1) / 2;
+						last = victim.last;
+						victim.last = first;
+					}
+
+					auto const guard = std::lock_guard{own.lock};
+
+					own.next = first + 1;
+					own.last = last;
+
+					return first;
+				}
+
+				return std::nullopt;
+			}
+		};
+	}
+
+	/*
+		parses a buffer of records on several threads. the buffer is cut into chunks of about
+		options.chunk_size units at the boundaries split finds, and p is run over each chunk a
+		record at a time until the chunk is used up. p is shared by every thread, so it has to
+		be const parsable, see wrapped_parser.
+
+		the values come back in input order. the first error in the input ends them, with its
+		offset counted from begin, and chunks after the one that failed are not parsed or are
+		given up on. a record that succeeds without consuming anything fails the same way at
+		its position, it would otherwise be parsed forever.
+
+		make_context, if given, is called with the start of each chunk and returns the context
+		that chunk is parsed with, a memo_context for instance. an exception thrown by p or by
+		make_context is rethrown here once every thread has stopped.
+	*/
+	template <typename P, std::random_access_iterator It, typename Split = delimited<std::iter_value_t<It>>, typename... MakeContext>
+	requires (sizeof...(MakeContext) <= 1)
+	records<parser_value_t<P>, parser_error_t<P>> parse_records(P const& p, It const begin, It const end, Split const& split = {},
+								    record_options const& options = {}, MakeContext const&... make_context)
+	{
+		using value_type = parser_value_t<P>;
+		using error_type = parser_error_t<P>;
+
+		struct chunk {
+			It first;
+			It last;
+			std::vector<value_type> values;
+			std::optional<record_error<error_type>> error;
+			std::exception_ptr exception;
+		};
+
+		auto chunks = std::vector<chunk>{};
+		auto const size = std::max<std::size_t>(options.chunk_size, 1);
+
+		for (auto pos = begin; pos != end;) {
+			auto const ahead = std::min(size, static_cast<std::size_t>(end - pos));
+			auto const last = ahead == static_cast<std::size_t>(end - pos) ? end : split(pos + static_cast<std::iter_difference_t<It>>(ahead - 1), end);
+
+			chunks.push_back({pos, last, {}, {}, {}});
+			pos = last;
+		}
+
+		auto threads = options.threads ? options.threads : std::max(1u, std::thread::hardware_concurrency());
+		threads = std::min(threads, std::max<std::size_t>(chunks.size(), 1));
+
+		auto queue = detail::chunk_queue{chunks.size(), threads};
+
+		// chunks past the first that failed have nothing to contribute
+		auto failed = std::atomic<std::size_t>{std::numeric_limits<std::size_t>::max()};
+
+		auto const mark_failed = [&](std::size_t const index) {
+			for (auto seen = failed.load(std::memory_order_relaxed); index < seen && !failed.compare_exchange_weak(seen, index, std::memory_order_relaxed);) {}
+		};
+
+		auto const parse_chunk = [&](chunk& c, std::size_t const index) {
+			auto const offset = [&](It const pos) {
+				return static_cast<std::size_t>(pos - begin);
+			};
+
+			auto const fail = [&](record_error<error_type> e) {
+				c.error = std::move(e);
+
+				mark_failed(index);
+			};
+
+			auto run = [&](auto&... ctx) {
+				for (auto pos = c.first; pos != c.last;) {
+					if (failed.load(std::memory_order_relaxed) < index) {
+						return;
+					}
+
+					auto r = parse(p, pos, c.last, ctx...);
+
+					if (!r.has_value()) {
+						return fail({offset(r.pos()), std::move(r.error())});
+					} else if (r.pos() == pos) {
+						return fail({offset(pos), error_type{}});
+					}
+
+					c.values.push_back(std::move(r.value()));
+					pos = r.pos();
+				}
+			};
+
+			if constexpr(sizeof...(MakeContext) == 1) {
+				auto ctx = (make_context(c.first), ...);
+				run(ctx);
+			} else {
+				run();
+			}
+		};
+
+		auto const work = [&](std::size_t const worker) {
+			while (auto const index = queue.pop(worker)) {
+				auto& c = chunks[*index];
+
+				if (failed.load(std::memory_order_relaxed) < *index) {
+					continue;
+				}
+
+				try {
+					parse_chunk(c, *index);
+				} catch (...) {
+					c.exception = std::current_exception();
+					c.error.reset();
+					mark_failed(*index);
+				}
+			}
+		};
+
+		{
+			auto pool = std::vector<std::jthread>{};
+			pool.reserve(threads - 1);
+
+			for (auto i = std::size_t{1}; i < threads; ++i) {
+				pool.emplace_back(work, i);
+			}
+
+			work(0);
+		}
+
+		auto out = records<value_type, error_type>{};
+		auto total = std::size_t{};
+
+		for (auto const& c : chunks) {
+			total += c.values.size();
+		}
+
+		out.values.reserve(total);
+
+		for (auto& c : chunks) {
+			if (c.exception) {
+				std::rethrow_exception(c.exception);
+			}
+
+			std::move(c.values.begin(), c.values.end(), std::back_inserter(out.values));
+
+			if (c.error) {
+				out.error = std::move(c.error);
+				break;
+			}
+		}
+
+		return out;
+	}
+}
+
+#endif
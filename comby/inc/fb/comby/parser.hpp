@@ -1,10 +1,18 @@
 #ifndef FB_COMBY_PARSER_TRAITS_HPP
 #define FB_COMBY_PARSER_TRAITS_HPP
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <memory_resource>
 #include <type_traits>
 #include <optional>
 #include <variant>
 #include <functional>
+#include <iterator>
 #include "fb/tag_invoke.hpp"
+#ifdef FB_COMBY_PROFILE
+#include "fb/comby/profile.hpp"
+#endif
 
 namespace fb::comby {
 	namespace detail {
@@ -16,8 +24,42 @@ namespace fb::comby {
 
 		template <typename T, template <typename...> typename U>
 		concept template_of = is_template_of<T, U>::value;
+
+		// a parser the parse CPO reports to the profile, see named()
+		template <typename P>
+		concept profiled = requires(P const& p) {
+			p.profile_rule();
+		};
+
+#ifdef FB_COMBY_PROFILE
+		template <typename P, typename It, typename F>
+		constexpr auto profiled_call(P const& p, It const pos, F&& f) {
+			if constexpr(profiled<P>) {
+				if (!std::is_constant_evaluated()) {
+					auto scope = profile::scope{p.profile_rule()};
+					auto r = f();
+
+					scope.leave(r.has_value(), static_cast<std::size_t>(std::distance(pos, r.pos())));
+					return r;
+				}
+			}
+
+			return f();
+		}
+#endif
 	}
 
+	/*
+		the hook every call through parse goes by, nothing but the call unless profiling.
+		FB_COMBY_PROFILE changes the body of the CPO, so it has to be set the same way for
+		every translation unit of a program, as a project-wide compile definition.
+	*/
+#ifdef FB_COMBY_PROFILE
+#define FB_COMBY_PARSE_CALL(p, pos, ...) ::fb::comby::detail::profiled_call(p, pos, [&] { return __VA_ARGS__; })
+#else
+#define FB_COMBY_PARSE_CALL(p, pos, ...) __VA_ARGS__
+#endif
+
 	template <typename P> using parser_char_t = typename P::char_type;
 	template <typename P> using parser_value_t = typename P::value_type;
 	template <typename P> using parser_error_t = typename P::error_type;
@@ -27,80 +69,275 @@ namespace fb::comby {
 		constexpr auto operator()(P&& p, It pos, S end) const noexcept(fb::is_nothrow_tag_invocable_v<parse_t, P&&, It, S>)
 									    -> fb::tag_invoke_result_t<parse_t, P&&, It, S>
 		{
-			return fb::tag_invoke(*this, std::forward<P>(p), pos, end);
+			return FB_COMBY_PARSE_CALL(p, pos, fb::tag_invoke(*this, std::forward<P>(p), pos, end));
+		}
+
+		// parsers that take no context are parsed without it
+		template <typename P, typename It, typename S, typename C>
+		requires fb::tag_invocable<parse_t, P&&, It, S, C&>
+		constexpr auto operator()(P&& p, It pos, S end, C& ctx) const noexcept(fb::is_nothrow_tag_invocable_v<parse_t, P&&, It, S, C&>)
+									    -> fb::tag_invoke_result_t<parse_t, P&&, It, S, C&>
+		{
+			return FB_COMBY_PARSE_CALL(p, pos, fb::tag_invoke(*this, std::forward<P>(p), pos, end, ctx));
+		}
+
+		template <typename P, typename It, typename S, typename C>
+		constexpr auto operator()(P&& p, It pos, S end, C&) const noexcept(fb::is_nothrow_tag_invocable_v<parse_t, P&&, It, S>)
+									    -> fb::tag_invoke_result_t<parse_t, P&&, It, S>
+		{
+			return FB_COMBY_PARSE_CALL(p, pos, fb::tag_invoke(*this, std::forward<P>(p), pos, end));
 		}
 	} parse = {};
 
+#undef FB_COMBY_PARSE_CALL
+
+	/*
+		state shared by every parser taking part in one parse, handed down as parse(p, pos, end, ctx).
+		values should allocate from resource(), so that a parse into an arena frees all at once and
+		values dropped while backtracking return nothing to the global allocator.
+	*/
+	class parse_context {
+	private:
+		std::pmr::memory_resource* m_resource;
+
+	public:
+		parse_context() noexcept :
+			m_resource{std::pmr::get_default_resource()}
+		{}
+
+		explicit parse_context(std::pmr::memory_resource* const resource) noexcept :
+			m_resource{resource}
+		{}
+
+		std::pmr::memory_resource* resource() const noexcept {
+			return m_resource;
+		}
+
+		template <typename T = std::byte>
+		std::pmr::polymorphic_allocator<T> allocator() const noexcept {
+			return std::pmr::polymorphic_allocator<T>{m_resource};
+		}
+
+		// a node that lives as long as the resource, it is never destroyed
+		template <typename T, typename... Args>
+		T* make(Args&&... args) const {
+			return allocator<T>().template new_object<T>(std::forward<Args>(args)...);
+		}
+	};
+
 	inline constexpr struct default_result_t {} default_result;
 
+	/*
+		the outcome of a parse, either a value or an error, and the position the parser stopped
+		at. the sentinel is the one that was passed in, so it is not kept. the value and error
+		share storage behind a one byte status, and a result of trivially copyable V and E is
+		itself trivially copyable so it is passed back up in registers.
+
+		as with std::variant, a value or error whose constructor throws leaves the result
+		valueless_by_exception(), holding neither until something else is set.
+	*/
 	template <typename CharT, typename V, typename E, typename It, typename S>
-	class parser_result : public std::variant<E, V> {
+	class parser_result {
 	public:
 		using char_type = CharT;
 		using value_type = V;
 		using error_type = E;
 		using iterator = It;
 		using sentinel = S;
-		using variant_type = std::variant<error_type, value_type>;
-		using variant_type::variant;
 
 	private:
+		static constexpr bool trivial = std::is_trivially_copyable_v<value_type> && std::is_trivially_destructible_v<value_type>
+		                             && std::is_trivially_copyable_v<error_type> && std::is_trivially_destructible_v<error_type>;
+
 		iterator m_pos;
-		sentinel m_end;
+
+		union {
+			error_type m_error;
+			value_type m_value;
+		};
+
+		std::uint8_t m_index;
+
+		static constexpr std::uint8_t valueless = 2;
+
+		constexpr void destroy() noexcept {
+			if (m_index == 1) {
+				std::destroy_at(&m_value);
+			} else if (m_index == 0) {
+				std::destroy_at(&m_error);
+			}
+
+			m_index = valueless;
+		}
+
+		// into a result holding nothing, which stays valueless if construction throws
+		constexpr void assign(parser_result const& other) {
+			if (other.m_index == 1) {
+				std::construct_at(&m_value, other.m_value);
+			} else if (other.m_index == 0) {
+				std::construct_at(&m_error, other.m_error);
+			}
+
+			m_index = other.m_index;
+		}
+
+		constexpr void assign(parser_result&& other) {
+			if (other.m_index == 1) {
+				std::construct_at(&m_value, std::move(other.m_value));
+			} else if (other.m_index == 0) {
+				std::construct_at(&m_error, std::move(other.m_error));
+			}
+
+			m_index = other.m_index;
+		}
 
 	public:
-		explicit constexpr parser_result(default_result_t, iterator pos, sentinel end) :
+		// starts out as a default constructed error at pos
+		explicit constexpr parser_result(default_result_t, iterator pos) :
 			m_pos{pos},
-			m_end{end}
+			m_error{},
+			m_index{0}
 		{}
 
-		constexpr void set_error(error_type const& err, iterator pos, sentinel end) {
-			emplace<0>(err);
-			m_pos = pos;
-			m_end = end;
+		constexpr parser_result(parser_result const&) requires trivial = default;
+
+		constexpr parser_result(parser_result const& other) :
+			m_pos{other.m_pos},
+			m_index{valueless}
+		{
+			assign(other);
 		}
 
-		constexpr void set_error(error_type&& err, iterator pos, sentinel end) {
-			emplace<0>(std::move(err));
-			m_pos = pos;
-			m_end = end;
+		constexpr parser_result(parser_result&&) requires trivial = default;
+
+		constexpr parser_result(parser_result&& other) noexcept(std::is_nothrow_move_constructible_v<value_type> && std::is_nothrow_move_constructible_v<error_type>) :
+			m_pos{other.m_pos},
+			m_index{valueless}
+		{
+			assign(std::move(other));
+		}
+
+		constexpr parser_result& operator=(parser_result const&) requires trivial = default;
+
+		constexpr parser_result& operator=(parser_result const& other) {
+			if (this != &other) {
+				destroy();
+				assign(other);
+				m_pos = other.m_pos;
+			}
+
+			return *this;
+		}
+
+		constexpr parser_result& operator=(parser_result&&) requires trivial = default;
+
+		constexpr parser_result& operator=(parser_result&& other) {
+			if (this != &other) {
+				destroy();
+				assign(std::move(other));
+				m_pos = other.m_pos;
+			}
+
+			return *this;
+		}
+
+		constexpr ~parser_result() requires trivial = default;
+
+		constexpr ~parser_result() {
+			destroy();
 		}
 
-		constexpr void set_value(value_type const& v, iterator pos, sentinel end) {
-			emplace<1>(v);
+		template <typename... Args>
+		constexpr error_type& emplace_error(iterator pos, Args&&... args) {
+			destroy();
 			m_pos = pos;
-			m_end = end;
+
+			auto& e = *std::construct_at(&m_error, std::forward<Args>(args)...);
+			m_index = 0;
+			return e;
 		}
 
-		constexpr void set_value(value_type&& v, iterator pos, sentinel end) {
-			emplace<1>(std::move(v));
+		template <typename... Args>
+		constexpr value_type& emplace_value(iterator pos, Args&&... args) {
+			destroy();
 			m_pos = pos;
-			m_end = end;
+
+			auto& v = *std::construct_at(&m_value, std::forward<Args>(args)...);
+			m_index = 1;
+			return v;
+		}
+
+		constexpr void set_error(error_type const& err, iterator pos) {
+			emplace_error(pos, err);
+		}
+
+		constexpr void set_error(error_type&& err, iterator pos) {
+			emplace_error(pos, std::move(err));
+		}
+
+		constexpr void set_value(value_type const& v, iterator pos) {
+			emplace_value(pos, v);
+		}
+
+		constexpr void set_value(value_type&& v, iterator pos) {
+			emplace_value(pos, std::move(v));
+		}
+
+		// 0 for an error, 1 for a value, std::variant_npos for neither
+		constexpr std::size_t index() const noexcept {
+			return m_index == valueless ? std::variant_npos : m_index;
+		}
+
+		constexpr bool has_value() const noexcept {
+			return m_index == 1;
+		}
+
+		constexpr bool valueless_by_exception() const noexcept {
+			return m_index == valueless;
 		}
 
 		constexpr error_type& error() {
-			return std::get<0>(*this);
+			if (m_index != 0) {
+				throw std::bad_variant_access{};
+			}
+
+			return m_error;
 		}
 
 		constexpr error_type const& error() const {
-			return std::get<0>(*this);
+			if (m_index != 0) {
+				throw std::bad_variant_access{};
+			}
+
+			return m_error;
 		}
 
 		constexpr value_type& value() {
-			return std::get<1>(*this);
+			if (m_index != 1) {
+				throw std::bad_variant_access{};
+			}
+
+			return m_value;
 		}
 
 		constexpr value_type const& value() const {
-			return std::get<1>(*this);
+			if (m_index != 1) {
+				throw std::bad_variant_access{};
+			}
+
+			return m_value;
 		}
 
 		constexpr iterator pos() const noexcept {
 			return m_pos;
 		}
+	};
 
-		constexpr sentinel end() const noexcept {
-			return m_end;
-		}
+	// an error of one record among many, placed by its offset from the start of the whole input
+	template <typename E>
+	struct record_error {
+		std::size_t offset;
+		E error;
 	};
 
 	template <typename P>
@@ -125,6 +362,13 @@ namespace fb::comby {
 	private:
 		invocable_type m_f;
 
+		// f as seen through a wrapped_parser that may be const
+		template <typename Self>
+		using invocable_as = std::conditional_t<std::is_const_v<Self>, invocable_type const, invocable_type>&;
+
+		template <typename It, typename S>
+		using result_type = parser_result<char_type, value_type, error_type, It, S>;
+
 	public:
 		constexpr wrapped_parser() = delete;
 		constexpr wrapped_parser(wrapped_parser const&) = default;
@@ -141,22 +385,40 @@ namespace fb::comby {
 		constexpr wrapped_parser& operator=(wrapped_parser const&) = default;
 		constexpr wrapped_parser& operator=(wrapped_parser&&) = default;
 
-		template <typename It, typename S>
-		friend constexpr parser_result<char_type, value_type, error_type, It, S> tag_invoke(fb::tag_t<parse>, wrapped_parser& p, It pos, S end) {
-			auto r = parser_result<char_type, value_type, error_type, It, S>{default_result, pos, end};
+		/*
+			a const wrapped_parser calls f as const, so a grammar of them can be shared between
+			threads as long as f keeps its state in the context rather than in its captures.
+			a mutable f can still be parsed through a non-const reference.
+		*/
+		template <typename Self, typename It, typename S>
+		requires std::is_same_v<std::remove_const_t<Self>, wrapped_parser>
+		      && std::is_invocable_v<invocable_as<Self>, It, S, result_type<It, S>&>
+		friend constexpr result_type<It, S> tag_invoke(fb::tag_t<parse>, Self& p, It pos, S end) {
+			auto r = result_type<It, S>{default_result, pos};
 			std::invoke(p.m_f, pos, end, r);
 			return r;
 		}
-	};
 
-	template <typename CharT, typename V, typename E, typename F>
-	constexpr wrapped_parser<CharT, V, E, F> as_parser(F const& f) {
-		return {f};
-	}
+		// f is handed the context when it takes one as a fourth argument
+		template <typename Self, typename It, typename S, typename C>
+		requires std::is_same_v<std::remove_const_t<Self>, wrapped_parser>
+		      && (std::is_invocable_v<invocable_as<Self>, It, S, result_type<It, S>&, C&> || std::is_invocable_v<invocable_as<Self>, It, S, result_type<It, S>&>)
+		friend constexpr result_type<It, S> tag_invoke(fb::tag_t<parse>, Self& p, It pos, S end, C& ctx) {
+			auto r = result_type<It, S>{default_result, pos};
+
+			if constexpr(std::is_invocable_v<invocable_as<Self>, It, S, result_type<It, S>&, C&>) {
+				std::invoke(p.m_f, pos, end, r, ctx);
+			} else {
+				std::invoke(p.m_f, pos, end, r);
+			}
+
+			return r;
+		}
+	};
 
 	template <typename CharT, typename V, typename E, typename F>
-	constexpr wrapped_parser<CharT, V, E, F> as_parser(F&& f) {
-		return {std::move(f)};
+	constexpr wrapped_parser<CharT, V, E, std::remove_cvref_t<F>> as_parser(F&& f) {
+		return wrapped_parser<CharT, V, E, std::remove_cvref_t<F>>{std::forward<F>(f)};
 	}
 }
 
@@ -0,0 +1,361 @@
+#ifndef FB_COMBY_PROFILE_HPP
+#define FB_COMBY_PROFILE_HPP
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <map>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <vector>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+/*
+	a profile of the rules of a grammar, gathered where the parse CPO calls them. it is only
+	compiled in with FB_COMBY_PROFILE defined, without it the CPO calls every parser directly
+	and named() rules are registered but never counted. the define has to be the same for
+	every translation unit of a program, set it project-wide rather than per file.
+
+	a rule is a parser wrapped with named(), everything it calls that isn't named itself is
+	counted as its own time. each thread keeps its own counts and call tree, folded into
+	one another when a report is made or a thread exits, so reports are to be made while no
+	other thread is parsing.
+
+	counting grows each thread's tables as new rules and call paths show up, inside the
+	noexcept parse CPO, and a thread's first call registers it under a lock. a call that
+	can't be counted, for lack of memory or because that lock throws, is left out of the
+	profile instead of ending the program.
+*/
+namespace fb::comby::profile {
+	using rule_id = std::size_t;
+
+	struct rule_stats {
+		std::string_view name;
+		std::size_t calls = 0;
+		std::size_t failures = 0;
+
+		// units consumed by successes, and from the start to where a failure stopped
+		std::size_t consumed = 0;
+		std::size_t backtracked = 0;
+
+		// timestamp counter ticks, total counts a recursive rule once at its outermost call
+		std::uint64_t self_cycles = 0;
+		std::uint64_t total_cycles = 0;
+	};
+
+	namespace detail {
+		inline std::uint64_t now() noexcept {
+#if defined(__x86_64__) || defined(__i386__)
+			return __rdtsc();
+#else
+			return static_cast<std::uint64_t>(std::chrono::steady_clock::now().time_since_epoch().count());
+#endif
+		}
+
+		// a call path of rules, and the self time spent at its end
+		using stacks = std::map<std::vector<rule_id>, std::uint64_t>;
+
+		struct thread_profile;
+
+		struct shared_state {
+			std::mutex lock;
+			std::vector<std::string_view> names;
+			std::vector<rule_stats> retired;
+			stacks retired_stacks;
+			std::vector<thread_profile*> live;
+		};
+
+		inline shared_state& shared() {
+			static auto state = shared_state{};
+			return state;
+		}
+
+		inline void add(std::vector<rule_stats>& to, std::vector<rule_stats> const& from) {
+			to.resize(std::max(to.size(), from.size()));
+
+			for (auto i = std::size_t{}; i < from.size(); ++i) {
+				to[i].calls += from[i].calls;
+				to[i].failures += from[i].failures;
+				to[i].consumed += from[i].consumed;
+				to[i].backtracked += from[i].backtracked;
+				to[i].self_cycles += from[i].self_cycles;
+				to[i].total_cycles += from[i].total_cycles;
+			}
+		}
+
+		struct thread_profile {
+			struct node {
+				rule_id rule;
+				std::size_t parent;
+				std::uint64_t self = 0;
+				std::vector<std::size_t> children;
+			};
+
+			struct frame {
+				std::uint64_t start = 0;
+				std::uint64_t children = 0;
+			};
+
+			std::vector<rule_stats> rules;
+			std::vector<std::size_t> depth;
+			std::vector<node> nodes{{0, 0}};
+			std::vector<frame> frames;
+			std::size_t current = 0;
+
+			thread_profile() {
+				auto const guard = std::lock_guard{shared().lock};
+				shared().live.push_back(this);
+			}
+
+			~thread_profile() {
+				auto& s = shared();
+				auto const guard = std::lock_guard{s.lock};
+
+				add(s.retired, rules);
+				collect(s.retired_stacks);
+				std::erase(s.live, this);
+			}
+
+			// everything that allocates comes first, a throw leaves the profile as it was
+			void enter(rule_id const rule) {
+				if (rule >= rules.size()) {
+					depth.resize(rule + 1);
+					rules.resize(rule + 1);
+				}
+
+				frames.emplace_back();
+
+				auto& children = nodes[current].children;
+				auto const it = std::find_if(children.begin(), children.end(), [&](std::size_t const c) {
+					return nodes[c].rule == rule;
+				});
+
+				if (it != children.end()) {
+					current = *it;
+				} else {
+					try {
+						children.reserve(children.size() + 1);
+						nodes.push_back({rule, current});
+					} catch (...) {
+						frames.pop_back();
+						throw;
+					}
+
+					nodes[current].children.push_back(nodes.size() - 1);
+					current = nodes.size() - 1;
+				}
+
+				++depth[rule];
+				frames.back().start = now();
+			}
+
+			void leave(bool const success, std::size_t const distance) noexcept {
+				auto const elapsed = now() - frames.back().start;
+				auto const self = elapsed - std::min(elapsed, frames.back().children);
+				auto& stats = rules[nodes[current].rule];
+
+				frames.pop_back();
+
+				if (!frames.empty()) {
+					frames.back().children += elapsed;
+				}
+
+				++stats.calls;
+				stats.failures += !success;
+				(success ? stats.consumed : stats.backtracked) += distance;
+				stats.self_cycles += self;
+
+				if (!--depth[nodes[current].rule]) {
+					stats.total_cycles += elapsed;
+				}
+
+				nodes[current].self += self;
+				current = nodes[current].parent;
+			}
+
+			void collect(stacks& out) const {
+				auto path = std::vector<rule_id>{};
+
+				for (auto i = std::size_t{1}; i < nodes.size(); ++i) {
+					if (!nodes[i].self) {
+						continue;
+					}
+
+					path.clear();
+
+					for (auto n = i; n; n = nodes[n].parent) {
+						path.push_back(nodes[n].rule);
+					}
+
+					std::reverse(path.begin(), path.end());
+					out[path] += nodes[i].self;
+				}
+			}
+
+			void clear() {
+				rules.assign(rules.size(), {});
+				nodes.resize(1);
+				nodes[0].children.clear();
+				current = 0;
+			}
+		};
+
+		inline thread_profile& this_thread() {
+			thread_local auto profile = thread_profile{};
+			return profile;
+		}
+
+		template <typename F>
+		auto merged(F&& f) {
+			auto& s = shared();
+			auto const guard = std::lock_guard{s.lock};
+			auto rules = s.retired;
+			auto stacks = s.retired_stacks;
+
+			for (auto const* t : s.live) {
+				add(rules, t->rules);
+				t->collect(stacks);
+			}
+
+			rules.resize(s.names.size());
+
+			for (auto i = std::size_t{}; i < rules.size(); ++i) {
+				rules[i].name = s.names[i];
+			}
+
+			return f(rules, stacks);
+		}
+	}
+
+	// a new rule reported as name, which has to outlive every report
+	inline rule_id register_rule(std::string_view const name) {
+		auto& s = detail::shared();
+		auto const guard = std::lock_guard{s.lock};
+
+		s.names.push_back(name);
+		return s.names.size() - 1;
+	}
+
+	/*
+		one call of a rule, from entering it to leave() with how it went. a call left by an
+		exception is counted as a failure that went nowhere, one that couldn't be entered
+		isn't counted at all.
+	*/
+	class scope {
+	private:
+		bool m_left = false;
+
+	public:
+		explicit scope(rule_id const rule) noexcept {
+			try {
+				detail::this_thread().enter(rule);
+			} catch (...) {
+				m_left = true;
+			}
+		}
+
+		scope(scope const&) = delete;
+		scope& operator=(scope const&) = delete;
+
+		void leave(bool const success, std::size_t const distance) noexcept {
+			if (!m_left) {
+				detail::this_thread().leave(success, distance);
+				m_left = true;
+			}
+		}
+
+		~scope() {
+			if (!m_left) {
+				detail::this_thread().leave(false, 0);
+			}
+		}
+	};
+
+	// every rule's counts over every thread, in the order they were registered
+	inline std::vector<rule_stats> rules() {
+		return detail::merged([](auto& rules, auto&) {
+			return std::move(rules);
+		});
+	}
+
+	// one line per rule that was called, the most self time first
+	inline std::string flat() {
+		auto stats = rules();
+		auto total = std::uint64_t{};
+
+		std::erase_if(stats, [](rule_stats const& r) {
+			return !r.calls;
+		});
+
+		std::sort(stats.begin(), stats.end(), [](rule_stats const& a, rule_stats const& b) {
+			return a.self_cycles > b.self_cycles;
+		});
+
+		for (auto const& r : stats) {
+			total += r.self_cycles;
+		}
+
+		auto out = std::string{};
+		auto line = std::array<char, 256>{};
+
+		std::snprintf(line.data(), line.size(), "%-24s %12s %12s %14s %14s %7s %16s %16s\n",
+			      "rule", "calls", "failures", "consumed", "backtracked", "self%", "self cycles", "total cycles");
+		out += line.data();
+
+		for (auto const& r : stats) {
+			std::snprintf(line.data(), line.size(), "%-24.*s %12zu %12zu %14zu %14zu %6.2f%% %16llu %16llu\n",
+				      static_cast<int>(r.name.size()), r.name.data(), r.calls, r.failures, r.consumed, r.backtracked,
+				      total ? 100.0 * static_cast<double>(r.self_cycles) / static_cast<double>(total) : 0.0,
+				      static_cast<unsigned long long>(r.self_cycles), static_cast<unsigned long long>(r.total_cycles));
+			out += line.data();
+		}
+
+		return out;
+	}
+
+	// a line per call path with its self cycles, as flamegraph.pl and speedscope read them
+	inline std::string folded() {
+		return detail::merged([](auto& rules, auto& stacks) {
+			auto out = std::string{};
+
+			for (auto const& [path, cycles] : stacks) {
+				for (auto i = std::size_t{}; i < path.size(); ++i) {
+					auto name = std::string{rules[path[i]].name};
+
+					// ';' separates frames and a space the count
+					std::replace(name.begin(), name.end(), ';', ',');
+					std::replace(name.begin(), name.end(), ' ', '_');
+
+					out += i ? ";" : "";
+					out += name;
+				}
+
+				out += ' ';
+				out += std::to_string(cycles);
+				out += '\n';
+			}
+
+			return out;
+		});
+	}
+
+	// forgets every count, the rules stay registered. only call it between parses
+	inline void reset() {
+		auto& s = detail::shared();
+		auto const guard = std::lock_guard{s.lock};
+
+		s.retired.clear();
+		s.retired_stacks.clear();
+
+		for (auto* t : s.live) {
+			t->clear();
+		}
+	}
+}
+
+#endif
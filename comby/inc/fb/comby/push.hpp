@@ -0,0 +1,342 @@
+#ifndef FB_COMBY_PUSH_HPP
+#define FB_COMBY_PUSH_HPP
+#include <cstddef>
+#include <compare>
+#include <coroutine>
+#include <exception>
+#include <iterator>
+#include <memory>
+#include <optional>
+#include <span>
+#include <type_traits>
+#include <utility>
+#include <vector>
+#include "fb/comby/parser.hpp"
+
+namespace fb::comby {
+	namespace detail {
+		/*
+			a pointer into the input buffered so far. comparing it equal to a push_sentinel is
+			how a parser finds it has run out of input, which the sentinel notes down: whatever
+			the parser decided there could change once more input arrives.
+
+			the sentinel can't be subtracted from, so bulk paths that would read up to the end
+			unseen fall back to stepping through the units.
+		*/
+		template <typename CharT>
+		class push_iterator {
+		public:
+			using iterator_concept = std::contiguous_iterator_tag;
+			using iterator_category = std::random_access_iterator_tag;
+			using value_type = CharT;
+			using element_type = CharT const;
+			using difference_type = std::ptrdiff_t;
+			using pointer = CharT const*;
+			using reference = CharT const&;
+
+		private:
+			pointer m_p = nullptr;
+
+		public:
+			constexpr push_iterator() = default;
+
+			explicit constexpr push_iterator(pointer const p) noexcept :
+				m_p{p}
+			{}
+
+			constexpr reference operator*() const noexcept {
+				return *m_p;
+			}
+
+			constexpr pointer operator->() const noexcept {
+				return m_p;
+			}
+
+			constexpr reference operator[](difference_type const n) const noexcept {
+				return m_p[n];
+			}
+
+			constexpr push_iterator& operator++() noexcept {
+				++m_p;
+				return *this;
+			}
+
+			constexpr push_iterator operator++(int) noexcept {
+				return push_iterator{m_p++};
+			}
+
+			constexpr push_iterator& operator--() noexcept {
+				--m_p;
+				return *this;
+			}
+
+			constexpr push_iterator operator--(int) noexcept {
+				return push_iterator{m_p--};
+			}
+
+			constexpr push_iterator& operator+=(difference_type const n) noexcept {
+				m_p += n;
+				return *this;
+			}
+
+			constexpr push_iterator& operator-=(difference_type const n) noexcept {
+				m_p -= n;
+				return *this;
+			}
+
+			friend constexpr push_iterator operator+(push_iterator it, difference_type const n) noexcept {
+				return it += n;
+			}
+
+			friend constexpr push_iterator operator+(difference_type const n, push_iterator it) noexcept {
+				return it += n;
+			}
+
+			friend constexpr push_iterator operator-(push_iterator it, difference_type const n) noexcept {
+				return it -= n;
+			}
+
+			friend constexpr difference_type operator-(push_iterator const a, push_iterator const b) noexcept {
+				return a.m_p - b.m_p;
+			}
+
+			friend constexpr bool operator==(push_iterator const, push_iterator const) noexcept = default;
+			friend constexpr std::strong_ordering operator<=>(push_iterator const, push_iterator const) noexcept = default;
+		};
+
+		template <typename CharT>
+		class push_sentinel {
+		private:
+			CharT const* m_end = nullptr;
+			bool* m_seen = nullptr;
+
+		public:
+			constexpr push_sentinel() = default;
+
+			constexpr push_sentinel(CharT const* const end, bool& seen) noexcept :
+				m_end{end},
+				m_seen{&seen}
+			{}
+
+			friend constexpr bool operator==(push_iterator<CharT> const it, push_sentinel const s) noexcept {
+				if (std::to_address(it) != s.m_end) {
+					return false;
+				}
+
+				*s.m_seen = true;
+				return true;
+			}
+		};
+
+		// resumed for each value, it suspends without one when it needs more input
+		template <typename T>
+		class push_task {
+		public:
+			struct promise_type {
+				std::optional<T> value;
+				std::exception_ptr exception;
+
+				push_task get_return_object() noexcept {
+					return push_task{std::coroutine_handle<promise_type>::from_promise(*this)};
+				}
+
+				std::suspend_always initial_suspend() const noexcept {
+					return {};
+				}
+
+				std::suspend_always final_suspend() const noexcept {
+					return {};
+				}
+
+				std::suspend_always yield_value(T v) {
+					value.emplace(std::move(v));
+					return {};
+				}
+
+				void return_void() const noexcept {}
+
+				void unhandled_exception() noexcept {
+					exception = std::current_exception();
+				}
+			};
+
+		private:
+			std::coroutine_handle<promise_type> m_handle;
+
+			explicit push_task(std::coroutine_handle<promise_type> const handle) noexcept :
+				m_handle{handle}
+			{}
+
+		public:
+			push_task(push_task&& other) noexcept :
+				m_handle{std::exchange(other.m_handle, nullptr)}
+			{}
+
+			push_task& operator=(push_task&&) = delete;
+
+			~push_task() {
+				if (m_handle) {
+					m_handle.destroy();
+				}
+			}
+
+			bool done() const noexcept {
+				return m_handle.done();
+			}
+
+			std::optional<T> resume() {
+				auto& promise = m_handle.promise();
+
+				promise.value.reset();
+				m_handle.resume();
+
+				if (promise.exception) {
+					std::rethrow_exception(std::exchange(promise.exception, nullptr));
+				}
+
+				return std::move(promise.value);
+			}
+		};
+	}
+
+	/*
+		parses input that arrives a chunk at a time, such as off a socket, into a value per
+		record as soon as each is complete. P is parsed over the input buffered so far, and
+		when it reaches the end of that the parse is dropped and the coroutine suspends until
+		feed() brings more, to be parsed again from the start of the record.
+
+		only the record being parsed is kept, input before it is released as the buffer is
+		compacted, so memory is bounded by the longest span a record is parsed over rather
+		than by the whole message. a record that keeps needing more input is parsed again
+		for every chunk.
+
+		the first error ends the stream, with its offset counted from the first unit fed. so
+		does a record that succeeds without consuming anything, as it would repeat forever,
+		which isn't P's error to report and is told apart by stalled().
+		a value viewing the input, such as literal's, is only valid until the next feed().
+
+		sized sentinels aren't offered, which SIMD paths and the utf8_ parsers need, and the
+		grammar is parsed without a context.
+	*/
+	template <typename P>
+	class push_parser {
+	public:
+		using char_type = parser_char_t<P>;
+		using value_type = parser_value_t<P>;
+		using error_type = parser_error_t<P>;
+		using parser_type = P;
+		using iterator = detail::push_iterator<char_type>;
+		using sentinel = detail::push_sentinel<char_type>;
+
+	private:
+		parser_type m_p;
+		std::vector<char_type> m_buffer;
+		std::size_t m_start = 0;
+		std::size_t m_offset = 0;
+		bool m_finished = false;
+		std::optional<record_error<error_type>> m_error;
+		std::optional<std::size_t> m_stalled;
+		detail::push_task<value_type> m_task;
+
+		detail::push_task<value_type> run() {
+			while (true) {
+				auto const* begin = m_buffer.data() + m_start;
+				auto const* end = m_buffer.data() + m_buffer.size();
+
+				if (begin == end) {
+					if (m_finished) {
+						co_return;
+					}
+
+					co_await std::suspend_always{};
+					continue;
+				}
+
+				auto seen = false;
+				auto r = parse(m_p, iterator{begin}, sentinel{end, seen});
+
+				if (seen && !m_finished) {
+					co_await std::suspend_always{};
+					continue;
+				}
+
+				auto const stop = static_cast<std::size_t>(std::to_address(r.pos()) - m_buffer.data());
+
+				if (!r.has_value()) {
+					m_error = record_error<error_type>{m_offset + stop, std::move(r.error())};
+					co_return;
+				} else if (stop == m_start) {
+					m_stalled = m_offset + stop;
+					co_return;
+				}
+
+				m_start = stop;
+				co_yield std::move(r.value());
+			}
+		}
+
+	public:
+		explicit push_parser(parser_type p) :
+			m_p{std::move(p)},
+			m_task{run()}
+		{}
+
+		// the coroutine refers back to the parser, which has to stay put
+		push_parser(push_parser const&) = delete;
+		push_parser& operator=(push_parser const&) = delete;
+
+		// appends chunk to the input, releasing whatever was parsed before it
+		void feed(std::span<char_type const> const chunk) {
+			if (m_start && m_start >= m_buffer.size() / 2) {
+				m_buffer.erase(m_buffer.begin(), m_buffer.begin() + static_cast<std::ptrdiff_t>(m_start));
+				m_offset += m_start;
+				m_start = 0;
+			}
+
+			m_buffer.insert(m_buffer.end(), chunk.begin(), chunk.end());
+		}
+
+		// no more input will arrive, the record at the end is parsed as it stands
+		void finish() noexcept {
+			m_finished = true;
+		}
+
+		// the next complete value, none until more input is fed or once the stream has ended
+		std::optional<value_type> next() {
+			if (m_task.done()) {
+				return std::nullopt;
+			}
+
+			return m_task.resume();
+		}
+
+		// whether every value has been delivered, or an error or a stall ended the stream
+		bool done() const noexcept {
+			return m_task.done();
+		}
+
+		std::optional<record_error<error_type>> const& error() const noexcept {
+			return m_error;
+		}
+
+		// the offset of a record that matched without consuming anything, ending the stream
+		std::optional<std::size_t> const& stalled() const noexcept {
+			return m_stalled;
+		}
+
+		// units held for the record being parsed
+		std::size_t buffered() const noexcept {
+			return m_buffer.size() - m_start;
+		}
+
+		// units in memory, including parsed input not yet released
+		std::size_t capacity() const noexcept {
+			return m_buffer.capacity();
+		}
+	};
+
+	template <typename P>
+	push_parser(P) -> push_parser<P>;
+}
+
+#endif
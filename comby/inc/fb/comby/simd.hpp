@@ -0,0 +1,1166 @@
+#ifndef FB_COMBY_SIMD_HPP
+#define FB_COMBY_SIMD_HPP
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <bit>
+#include <span>
+#include <type_traits>
+#include "fb/comby/concepts.hpp"
+#include "fb/comby/bit.hpp"
+#include "fb/comby/dispatch.hpp"
+#if defined(__SSE2__)
+#include <immintrin.h>
+#endif
+
+#if defined(__SSSE3__) || defined(FB_COMBY_DISPATCH)
+#define FB_COMBY_SIMD_SSSE3 1
+#endif
+
+#if defined(__AVX2__) || defined(FB_COMBY_DISPATCH)
+#define FB_COMBY_SIMD_AVX2 1
+#endif
+
+#if (defined(__AVX512F__) && defined(__AVX512BW__) && defined(__AVX512VL__)) || defined(FB_COMBY_DISPATCH)
+#define FB_COMBY_SIMD_AVX512 1
+#endif
+
+/*
+	contiguous byte kernels behind the bulk encoding paths. each kernel has a portable SWAR
+	version working 8 bytes at a time and SSE2/SSSE3/AVX2/AVX-512 versions, compiled either
+	because the translation unit targets them or for runtime dispatch. the unqualified names
+	call the kernels of dispatch::active_level().
+*/
+namespace fb::comby::simd {
+	namespace detail {
+		inline std::uint64_t load_u64(unsigned char const* p) noexcept {
+			auto w = std::uint64_t{};
+			std::memcpy(&w, p, sizeof(w));
+			return w;
+		}
+
+		inline constexpr auto high_bits = std::uint64_t{0x8080808080808080u};
+
+		// number of leading bytes in w below 0x80, given w has at least one that isn't
+		inline std::size_t ascii_in_word(std::uint64_t const w) noexcept {
+			auto const m = w & high_bits;
+
+			if constexpr(std::endian::native == std::endian::little) {
+				return static_cast<std::size_t>(std::countr_zero(m)) >> 3;
+			} else {
+				return static_cast<std::size_t>(std::countl_zero(m)) >> 3;
+			}
+		}
+
+		constexpr std::size_t utf8_sequence_length(unsigned char const b) noexcept {
+			return b < 0x80u ? 1 : b < 0xE0u ? 2 : b < 0xF0u ? 3 : 4;
+		}
+
+		// the largest code point boundary <= n, assuming p[0, n) passed validation
+		inline std::size_t utf8_boundary(unsigned char const* p, std::size_t const n) noexcept {
+			for (auto k = std::size_t{1}; k <= 4 && k <= n; ++k) {
+				auto const b = p[n - k];
+
+				if ((b & 0xC0u) != 0x80u) {
+					return k < utf8_sequence_length(b) ? n - k : n;
+				}
+			}
+
+			return n;
+		}
+
+		/*
+			tables for the lookup based validation from "Validating UTF-8 In Less Than One
+			Instruction Per Byte" (Keiser, Lemire). each byte is classified by the high and low
+			nibble of the previous byte and the high nibble of itself, the bits still set after
+			and'ing the three lookups are errors.
+		*/
+		inline constexpr unsigned char too_short = 1 << 0;
+		inline constexpr unsigned char too_long = 1 << 1;
+		inline constexpr unsigned char overlong_3 = 1 << 2;
+		inline constexpr unsigned char too_large = 1 << 3;
+		inline constexpr unsigned char surrogate = 1 << 4;
+		inline constexpr unsigned char overlong_2 = 1 << 5;
+		inline constexpr unsigned char too_large_1000 = 1 << 6;
+		inline constexpr unsigned char overlong_4 = 1 << 6;
+		inline constexpr unsigned char two_conts = 1 << 7;
+		inline constexpr unsigned char carry = too_short | too_long | two_conts;
+
+		alignas(16) inline constexpr auto utf8_byte_1_high = std::array<unsigned char, 16>{
+			too_long, too_long, too_long, too_long,
+			too_long, too_long, too_long, too_long,
+			two_conts, two_conts, two_conts, two_conts,
+			too_short | overlong_2,
+			too_short,
+			too_short | overlong_3 | surrogate,
+			too_short | too_large | too_large_1000 | overlong_4
+		};
+
+		alignas(16) inline constexpr auto utf8_byte_1_low = std::array<unsigned char, 16>{
+			carry | overlong_3 | overlong_2 | overlong_4,
+			carry | overlong_2,
+			carry,
+			carry,
+			carry | too_large,
+			carry | too_large | too_large_1000,
+			carry | too_large | too_large_1000,
+			carry | too_large | too_large_1000,
+			carry | too_large | too_large_1000,
+			carry | too_large | too_large_1000,
+			carry | too_large | too_large_1000,
+			carry | too_large | too_large_1000,
+			carry | too_large | too_large_1000,
+			carry | too_large | too_large_1000 | surrogate,
+			carry | too_large | too_large_1000,
+			carry | too_large | too_large_1000
+		};
+
+		alignas(16) inline constexpr auto utf8_byte_2_high = std::array<unsigned char, 16>{
+			too_short, too_short, too_short, too_short,
+			too_short, too_short, too_short, too_short,
+			too_long | overlong_2 | two_conts | overlong_3 | too_large_1000 | overlong_4,
+			too_long | overlong_2 | two_conts | overlong_3 | too_large,
+			too_long | overlong_2 | two_conts | surrogate | too_large,
+			too_long | overlong_2 | two_conts | surrogate | too_large,
+			too_short, too_short, too_short, too_short
+		};
+	}
+
+	/*
+		a set of byte values, as a 256 bit bitmap and split into the two 16 entry tables the
+		shuffle kernels classify with. row_low[h] holds the members h0 to h7 as bits, row_high[h]
+		the members h8 to hF.
+	*/
+	struct byte_class {
+		std::array<std::uint64_t, 4> bits{};
+		alignas(16) std::array<unsigned char, 16> row_low{};
+		alignas(16) std::array<unsigned char, 16> row_high{};
+
+		constexpr byte_class() noexcept = default;
+
+		explicit constexpr byte_class(std::array<std::uint64_t, 4> const& b) noexcept :
+			bits{b}
+		{
+			for (auto c = 0u; c < 256u; ++c) {
+				if ((bits[c >> 6] >> (c & 63)) & 1) {
+					(c & 8 ? row_high : row_low)[c >> 4] |= static_cast<unsigned char>(1u << (c & 7));
+				}
+			}
+		}
+
+		constexpr bool contains(unsigned char const c) const noexcept {
+			return (bits[c >> 6] >> (c & 63)) & 1;
+		}
+	};
+
+	namespace swar {
+		// a bitmap test per byte, there is nothing to gain from a word at a time
+		inline std::size_t class_prefix(unsigned char const* p, std::size_t const n, byte_class const& set) noexcept {
+			auto i = std::size_t{};
+
+			for (; i + 4 <= n; i += 4) {
+				if (!set.contains(p[i])) {
+					return i;
+				} else if (!set.contains(p[i + 1])) {
+					return i + 1;
+				} else if (!set.contains(p[i + 2])) {
+					return i + 2;
+				} else if (!set.contains(p[i + 3])) {
+					return i + 3;
+				}
+			}
+
+			for (; i < n && set.contains(p[i]); ++i) {}
+
+			return i;
+		}
+
+		inline std::size_t ascii_prefix(unsigned char const* p, std::size_t const n) noexcept {
+			auto i = std::size_t{};
+
+			for (; i + 8 <= n; i += 8) {
+				auto const w = detail::load_u64(p + i);
+
+				if (w & detail::high_bits) {
+					return i + detail::ascii_in_word(w);
+				}
+			}
+
+			while (i < n && p[i] < 0x80u) {
+				++i;
+			}
+
+			return i;
+		}
+
+		template <typename T>
+		inline std::size_t ascii_widen(unsigned char const* p, std::size_t const n, T* dst) noexcept {
+			auto i = std::size_t{};
+
+			for (; i + 8 <= n; i += 8) {
+				auto const w = detail::load_u64(p + i);
+
+				if (w & detail::high_bits) {
+					break;
+				}
+
+				for (auto j = std::size_t{}; j < 8; ++j) {
+					dst[i + j] = static_cast<T>(p[i + j]);
+				}
+			}
+
+			for (; i < n && p[i] < 0x80u; ++i) {
+				dst[i] = static_cast<T>(p[i]);
+			}
+
+			return i;
+		}
+
+		// widens the leading ASCII run to UTF-16 units, byte swapped if Swap
+		template <bool Swap>
+		inline std::size_t ascii_widen_utf16(unsigned char const* p, std::size_t const n, char16_t* dst) noexcept {
+			auto i = std::size_t{};
+
+			for (; i < n && p[i] < 0x80u; ++i) {
+				dst[i] = Swap ? static_cast<char16_t>(p[i] << 8) : static_cast<char16_t>(p[i]);
+			}
+
+			return i;
+		}
+
+		// narrows the leading run of ASCII UTF-16 units to bytes
+		template <bool Swap>
+		inline std::size_t ascii_narrow_utf16(char16_t const* p, std::size_t const n, unsigned char* dst) noexcept {
+			auto i = std::size_t{};
+
+			for (; i < n; ++i) {
+				auto const u = Swap ? bit::bswap(p[i]) : p[i];
+
+				if (u >= 0x80u) {
+					break;
+				}
+
+				dst[i] = static_cast<unsigned char>(u);
+			}
+
+			return i;
+		}
+
+		// widens the leading run of units that aren't surrogates, byte swapping them if Swap
+		template <bool Swap>
+		inline std::size_t utf16_widen(char16_t const* p, std::size_t const n, char32_t* dst) noexcept {
+			auto i = std::size_t{};
+
+			for (; i < n; ++i) {
+				auto const u = Swap ? bit::bswap(p[i]) : p[i];
+
+				if ((u & 0xF800u) == 0xD800u) {
+					break;
+				}
+
+				dst[i] = u;
+			}
+
+			return i;
+		}
+
+		template <std::size_t N>
+		inline std::size_t bswap(unsigned char const* src, std::size_t const n, unsigned char* dst) noexcept {
+			using word = std::conditional_t<N == 2, std::uint16_t, std::conditional_t<N == 4, std::uint32_t, std::uint64_t>>;
+
+			for (auto i = std::size_t{}; i < n; ++i) {
+				auto w = word{};
+				std::memcpy(&w, src + i * N, N);
+				w = bit::bswap(w);
+				std::memcpy(dst + i * N, &w, N);
+			}
+
+			return n;
+		}
+
+		// no table lookups without a byte shuffle, so only ASCII runs are accepted in bulk
+		inline std::size_t utf8_valid_prefix(unsigned char const* p, std::size_t const n) noexcept {
+			return ascii_prefix(p, n);
+		}
+
+		inline std::size_t count_byte(unsigned char const* p, std::size_t const n, unsigned char const b) noexcept {
+			auto const low = std::uint64_t{0x7F7F7F7F7F7F7F7Fu};
+			auto const needle = std::uint64_t{0x0101010101010101u} * b;
+			auto count = std::size_t{};
+			auto i = std::size_t{};
+
+			// a byte of x is zero exactly where its high bit is left, no carry crosses bytes
+			for (; i + 8 <= n; i += 8) {
+				auto const x = detail::load_u64(p + i) ^ needle;
+				count += static_cast<std::size_t>(std::popcount(~(((x & low) + low) | x) & detail::high_bits));
+			}
+
+			for (; i < n; ++i) {
+				count += p[i] == b;
+			}
+
+			return count;
+		}
+	}
+
+#if defined(__SSE2__)
+	namespace sse2 {
+		inline std::size_t ascii_prefix(unsigned char const* p, std::size_t const n) noexcept {
+			auto i = std::size_t{};
+
+			for (; i + 16 <= n; i += 16) {
+				auto const m = _mm_movemask_epi8(_mm_loadu_si128(reinterpret_cast<__m128i const*>(p + i)));
+
+				if (m) {
+					return i + static_cast<std::size_t>(std::countr_zero(static_cast<unsigned>(m)));
+				}
+			}
+
+			return i + swar::ascii_prefix(p + i, n - i);
+		}
+
+		inline std::size_t ascii_widen(unsigned char const* p, std::size_t const n, char32_t* dst) noexcept {
+			auto const zero = _mm_setzero_si128();
+			auto i = std::size_t{};
+
+			for (; i + 16 <= n; i += 16) {
+				auto const v = _mm_loadu_si128(reinterpret_cast<__m128i const*>(p + i));
+
+				if (_mm_movemask_epi8(v)) {
+					break;
+				}
+
+				auto const lo = _mm_unpacklo_epi8(v, zero);
+				auto const hi = _mm_unpackhi_epi8(v, zero);
+				auto* out = reinterpret_cast<__m128i*>(dst + i);
+
+				_mm_storeu_si128(out + 0, _mm_unpacklo_epi16(lo, zero));
+				_mm_storeu_si128(out + 1, _mm_unpackhi_epi16(lo, zero));
+				_mm_storeu_si128(out + 2, _mm_unpacklo_epi16(hi, zero));
+				_mm_storeu_si128(out + 3, _mm_unpackhi_epi16(hi, zero));
+			}
+
+			return i + swar::ascii_widen(p + i, n - i, dst + i);
+		}
+
+		// zero extending into the low or high byte of each unit is the byte swap
+		template <bool Swap>
+		inline std::size_t ascii_widen_utf16(unsigned char const* p, std::size_t const n, char16_t* dst) noexcept {
+			auto const zero = _mm_setzero_si128();
+			auto i = std::size_t{};
+
+			for (; i + 16 <= n; i += 16) {
+				auto const v = _mm_loadu_si128(reinterpret_cast<__m128i const*>(p + i));
+
+				if (_mm_movemask_epi8(v)) {
+					break;
+				}
+
+				auto* out = reinterpret_cast<__m128i*>(dst + i);
+
+				if constexpr(Swap) {
+					_mm_storeu_si128(out + 0, _mm_unpacklo_epi8(zero, v));
+					_mm_storeu_si128(out + 1, _mm_unpackhi_epi8(zero, v));
+				} else {
+					_mm_storeu_si128(out + 0, _mm_unpacklo_epi8(v, zero));
+					_mm_storeu_si128(out + 1, _mm_unpackhi_epi8(v, zero));
+				}
+			}
+
+			return i + swar::ascii_widen_utf16<Swap>(p + i, n - i, dst + i);
+		}
+
+		template <bool Swap>
+		inline std::size_t ascii_narrow_utf16(char16_t const* p, std::size_t const n, unsigned char* dst) noexcept {
+			auto const mask = _mm_set1_epi16(Swap ? static_cast<short>(0x80FF) : static_cast<short>(0xFF80));
+			auto const zero = _mm_setzero_si128();
+			auto i = std::size_t{};
+
+			for (; i + 16 <= n; i += 16) {
+				auto a = _mm_loadu_si128(reinterpret_cast<__m128i const*>(p + i));
+				auto b = _mm_loadu_si128(reinterpret_cast<__m128i const*>(p + i + 8));
+
+				if (_mm_movemask_epi8(_mm_cmpeq_epi16(_mm_and_si128(_mm_or_si128(a, b), mask), zero)) != 0xFFFF) {
+					break;
+				}
+
+				if constexpr(Swap) {
+					a = _mm_srli_epi16(a, 8);
+					b = _mm_srli_epi16(b, 8);
+				}
+
+				_mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), _mm_packus_epi16(a, b));
+			}
+
+			return i + swar::ascii_narrow_utf16<Swap>(p + i, n - i, dst + i);
+		}
+
+		// byte reverses units of N bytes, src may equal dst. returns the number of units done
+		template <std::size_t N>
+		inline std::size_t bswap(unsigned char const* src, std::size_t const n, unsigned char* dst) noexcept {
+			auto i = std::size_t{};
+
+			for (; i + 16 / N <= n; i += 16 / N) {
+				auto v = _mm_loadu_si128(reinterpret_cast<__m128i const*>(src + i * N));
+
+				if constexpr(N == 4) {
+					v = _mm_shufflehi_epi16(_mm_shufflelo_epi16(v, 0b10110001), 0b10110001);
+				} else if constexpr(N == 8) {
+					v = _mm_shufflehi_epi16(_mm_shufflelo_epi16(v, 0b00011011), 0b00011011);
+				}
+
+				v = _mm_or_si128(_mm_slli_epi16(v, 8), _mm_srli_epi16(v, 8));
+				_mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i * N), v);
+			}
+
+			return i;
+		}
+
+		// the surrogate test is done on the raw units, with the constants swapped to match
+		template <bool Swap>
+		inline __m128i utf16_surrogates(__m128i const v) noexcept {
+			auto const mask = _mm_set1_epi16(Swap ? 0x00F8 : static_cast<short>(0xF800));
+			auto const surrogate = _mm_set1_epi16(Swap ? 0x00D8 : static_cast<short>(0xD800));
+
+			return _mm_cmpeq_epi16(_mm_and_si128(v, mask), surrogate);
+		}
+
+		template <bool Swap>
+		inline std::size_t utf16_widen(char16_t const* p, std::size_t const n, char32_t* dst) noexcept {
+			auto const zero = _mm_setzero_si128();
+			auto i = std::size_t{};
+
+			for (; i + 8 <= n; i += 8) {
+				auto v = _mm_loadu_si128(reinterpret_cast<__m128i const*>(p + i));
+
+				if (_mm_movemask_epi8(utf16_surrogates<Swap>(v))) {
+					break;
+				}
+
+				if constexpr(Swap) {
+					v = _mm_or_si128(_mm_slli_epi16(v, 8), _mm_srli_epi16(v, 8));
+				}
+
+				auto* out = reinterpret_cast<__m128i*>(dst + i);
+
+				_mm_storeu_si128(out + 0, _mm_unpacklo_epi16(v, zero));
+				_mm_storeu_si128(out + 1, _mm_unpackhi_epi16(v, zero));
+			}
+
+			return i + swar::utf16_widen<Swap>(p + i, n - i, dst + i);
+		}
+
+		// matches pile up in byte counters, summed by psadbw before 255 blocks can wrap them
+		inline std::size_t count_byte(unsigned char const* p, std::size_t const n, unsigned char const b) noexcept {
+			auto const needle = _mm_set1_epi8(static_cast<char>(b));
+			auto total = _mm_setzero_si128();
+			auto i = std::size_t{};
+
+			while (n - i >= 16) {
+				auto counts = _mm_setzero_si128();
+
+				for (auto blocks = std::min<std::size_t>((n - i) / 16, 255); blocks; --blocks, i += 16) {
+					counts = _mm_sub_epi8(counts, _mm_cmpeq_epi8(_mm_loadu_si128(reinterpret_cast<__m128i const*>(p + i)), needle));
+				}
+
+				total = _mm_add_epi64(total, _mm_sad_epu8(counts, _mm_setzero_si128()));
+			}
+
+			alignas(16) auto lanes = std::array<std::uint64_t, 2>{};
+			_mm_store_si128(reinterpret_cast<__m128i*>(lanes.data()), total);
+
+			return static_cast<std::size_t>(lanes[0] + lanes[1]) + swar::count_byte(p + i, n - i, b);
+		}
+	}
+#endif
+
+#if defined(FB_COMBY_SIMD_SSSE3)
+	namespace ssse3 {
+		inline FB_COMBY_TARGET("ssse3") __m128i utf8_check(__m128i const input, __m128i const prev_input) noexcept {
+			auto const nibble = _mm_set1_epi8(0x0F);
+			auto const prev1 = _mm_alignr_epi8(input, prev_input, 15);
+			auto const prev2 = _mm_alignr_epi8(input, prev_input, 14);
+			auto const prev3 = _mm_alignr_epi8(input, prev_input, 13);
+
+			auto const byte_1_high = _mm_shuffle_epi8(_mm_load_si128(reinterpret_cast<__m128i const*>(detail::utf8_byte_1_high.data())),
+								  _mm_and_si128(_mm_srli_epi16(prev1, 4), nibble));
+			auto const byte_1_low = _mm_shuffle_epi8(_mm_load_si128(reinterpret_cast<__m128i const*>(detail::utf8_byte_1_low.data())),
+								 _mm_and_si128(prev1, nibble));
+			auto const byte_2_high = _mm_shuffle_epi8(_mm_load_si128(reinterpret_cast<__m128i const*>(detail::utf8_byte_2_high.data())),
+								  _mm_and_si128(_mm_srli_epi16(input, 4), nibble));
+
+			auto const special = _mm_and_si128(_mm_and_si128(byte_1_high, byte_1_low), byte_2_high);
+			auto const third = _mm_subs_epu8(prev2, _mm_set1_epi8(static_cast<char>(0xE0 - 0x80)));
+			auto const fourth = _mm_subs_epu8(prev3, _mm_set1_epi8(static_cast<char>(0xF0 - 0x80)));
+			auto const must_continue = _mm_and_si128(_mm_or_si128(third, fourth), _mm_set1_epi8(static_cast<char>(0x80)));
+
+			return _mm_xor_si128(must_continue, special);
+		}
+
+		// a sequence left open at the end of prev_input is an error if input is all ASCII
+		inline FB_COMBY_TARGET("ssse3") __m128i utf8_incomplete(__m128i const prev_input) noexcept {
+			auto const max = _mm_setr_epi8(-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+						       static_cast<char>(0xF0 - 1),
+						       static_cast<char>(0xE0 - 1),
+						       static_cast<char>(0xC0 - 1));
+
+			return _mm_subs_epu8(prev_input, max);
+		}
+
+		inline FB_COMBY_TARGET("ssse3") std::size_t utf8_valid_prefix(unsigned char const* p, std::size_t const n) noexcept {
+			auto const zero = _mm_setzero_si128();
+			auto prev = zero;
+			auto i = std::size_t{};
+
+			for (; i + 16 <= n; i += 16) {
+				auto const v = _mm_loadu_si128(reinterpret_cast<__m128i const*>(p + i));
+				auto const err = _mm_movemask_epi8(v) ? utf8_check(v, prev) : utf8_incomplete(prev);
+
+				if (_mm_movemask_epi8(_mm_cmpeq_epi8(err, zero)) != 0xFFFF) {
+					break;
+				}
+
+				prev = v;
+			}
+
+			return detail::utf8_boundary(p, i);
+		}
+
+		// the high nibble picks a row, the low nibble a bit of it, for all 256 byte values
+		inline FB_COMBY_TARGET("ssse3") __m128i class_members(__m128i const v, __m128i const row_low, __m128i const row_high) noexcept {
+			auto const nibble = _mm_set1_epi8(0x0F);
+			auto const bit_low = _mm_setr_epi8(1, 2, 4, 8, 16, 32, 64, -128, 0, 0, 0, 0, 0, 0, 0, 0);
+			auto const bit_high = _mm_setr_epi8(0, 0, 0, 0, 0, 0, 0, 0, 1, 2, 4, 8, 16, 32, 64, -128);
+			auto const hi = _mm_and_si128(_mm_srli_epi16(v, 4), nibble);
+			auto const lo = _mm_and_si128(v, nibble);
+			auto const low = _mm_and_si128(_mm_shuffle_epi8(row_low, hi), _mm_shuffle_epi8(bit_low, lo));
+			auto const high = _mm_and_si128(_mm_shuffle_epi8(row_high, hi), _mm_shuffle_epi8(bit_high, lo));
+
+			return _mm_cmpeq_epi8(_mm_or_si128(low, high), _mm_setzero_si128());
+		}
+
+		inline FB_COMBY_TARGET("ssse3") std::size_t class_prefix(unsigned char const* p, std::size_t const n, byte_class const& set) noexcept {
+			auto const row_low = _mm_load_si128(reinterpret_cast<__m128i const*>(set.row_low.data()));
+			auto const row_high = _mm_load_si128(reinterpret_cast<__m128i const*>(set.row_high.data()));
+			auto i = std::size_t{};
+
+			for (; i + 16 <= n; i += 16) {
+				auto const outside = _mm_movemask_epi8(class_members(_mm_loadu_si128(reinterpret_cast<__m128i const*>(p + i)), row_low, row_high));
+
+				if (outside) {
+					return i + static_cast<std::size_t>(std::countr_zero(static_cast<unsigned>(outside)));
+				}
+			}
+
+			return i + swar::class_prefix(p + i, n - i, set);
+		}
+
+		template <std::size_t N>
+		inline FB_COMBY_TARGET("ssse3") __m128i bswap_mask() noexcept {
+			alignas(16) auto mask = std::array<char, 16>{};
+
+			for (auto i = std::size_t{}; i < 16; ++i) {
+				mask[i] = static_cast<char>(i - i % N + N - 1 - i % N);
+			}
+
+			return _mm_load_si128(reinterpret_cast<__m128i const*>(mask.data()));
+		}
+
+		template <std::size_t N>
+		inline FB_COMBY_TARGET("ssse3") std::size_t bswap(unsigned char const* src, std::size_t const n, unsigned char* dst) noexcept {
+			auto const mask = bswap_mask<N>();
+			auto i = std::size_t{};
+
+			for (; i + 16 / N <= n; i += 16 / N) {
+				auto const v = _mm_loadu_si128(reinterpret_cast<__m128i const*>(src + i * N));
+				_mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i * N), _mm_shuffle_epi8(v, mask));
+			}
+
+			return i;
+		}
+
+		// the byte swap is folded into the shuffle that widens the units
+		template <bool Swap>
+		inline FB_COMBY_TARGET("ssse3") std::size_t utf16_widen(char16_t const* p, std::size_t const n, char32_t* dst) noexcept {
+			if constexpr(!Swap) {
+				return sse2::utf16_widen<Swap>(p, n, dst);
+			} else {
+				auto const lo = _mm_setr_epi8(1, 0, -1, -1, 3, 2, -1, -1, 5, 4, -1, -1, 7, 6, -1, -1);
+				auto const hi = _mm_setr_epi8(9, 8, -1, -1, 11, 10, -1, -1, 13, 12, -1, -1, 15, 14, -1, -1);
+				auto i = std::size_t{};
+
+				for (; i + 8 <= n; i += 8) {
+					auto const v = _mm_loadu_si128(reinterpret_cast<__m128i const*>(p + i));
+
+					if (_mm_movemask_epi8(sse2::utf16_surrogates<Swap>(v))) {
+						break;
+					}
+
+					auto* out = reinterpret_cast<__m128i*>(dst + i);
+
+					_mm_storeu_si128(out + 0, _mm_shuffle_epi8(v, lo));
+					_mm_storeu_si128(out + 1, _mm_shuffle_epi8(v, hi));
+				}
+
+				return i + swar::utf16_widen<Swap>(p + i, n - i, dst + i);
+			}
+		}
+	}
+#endif
+
+#if defined(FB_COMBY_SIMD_AVX2)
+	namespace avx2 {
+		inline FB_COMBY_TARGET("avx2") std::size_t ascii_prefix(unsigned char const* p, std::size_t const n) noexcept {
+			auto i = std::size_t{};
+
+			for (; i + 32 <= n; i += 32) {
+				auto const m = _mm256_movemask_epi8(_mm256_loadu_si256(reinterpret_cast<__m256i const*>(p + i)));
+
+				if (m) {
+					return i + static_cast<std::size_t>(std::countr_zero(static_cast<unsigned>(m)));
+				}
+			}
+
+			return i + sse2::ascii_prefix(p + i, n - i);
+		}
+
+		inline FB_COMBY_TARGET("avx2") std::size_t ascii_widen(unsigned char const* p, std::size_t const n, char32_t* dst) noexcept {
+			auto i = std::size_t{};
+
+			for (; i + 32 <= n; i += 32) {
+				auto const v = _mm256_loadu_si256(reinterpret_cast<__m256i const*>(p + i));
+
+				if (_mm256_movemask_epi8(v)) {
+					break;
+				}
+
+				auto* out = reinterpret_cast<__m256i*>(dst + i);
+
+				for (auto j = 0; j < 4; ++j) {
+					auto const bytes = _mm_loadl_epi64(reinterpret_cast<__m128i const*>(p + i + j * 8));
+					_mm256_storeu_si256(out + j, _mm256_cvtepu8_epi32(bytes));
+				}
+			}
+
+			return i + sse2::ascii_widen(p + i, n - i, dst + i);
+		}
+
+		template <std::size_t N>
+		inline FB_COMBY_TARGET("avx2") std::size_t bswap(unsigned char const* src, std::size_t const n, unsigned char* dst) noexcept {
+			auto const mask = _mm256_broadcastsi128_si256(ssse3::bswap_mask<N>());
+			auto i = std::size_t{};
+
+			for (; i + 32 / N <= n; i += 32 / N) {
+				auto const v = _mm256_loadu_si256(reinterpret_cast<__m256i const*>(src + i * N));
+				_mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + i * N), _mm256_shuffle_epi8(v, mask));
+			}
+
+			return i + ssse3::bswap<N>(src + i * N, n - i, dst + i * N);
+		}
+
+		template <bool Swap>
+		inline FB_COMBY_TARGET("avx2") std::size_t ascii_widen_utf16(unsigned char const* p, std::size_t const n, char16_t* dst) noexcept {
+			auto i = std::size_t{};
+
+			for (; i + 32 <= n; i += 32) {
+				auto const v = _mm256_loadu_si256(reinterpret_cast<__m256i const*>(p + i));
+
+				if (_mm256_movemask_epi8(v)) {
+					break;
+				}
+
+				auto lo = _mm256_cvtepu8_epi16(_mm256_castsi256_si128(v));
+				auto hi = _mm256_cvtepu8_epi16(_mm256_extracti128_si256(v, 1));
+
+				if constexpr(Swap) {
+					lo = _mm256_slli_epi16(lo, 8);
+					hi = _mm256_slli_epi16(hi, 8);
+				}
+
+				auto* out = reinterpret_cast<__m256i*>(dst + i);
+
+				_mm256_storeu_si256(out + 0, lo);
+				_mm256_storeu_si256(out + 1, hi);
+			}
+
+			return i + sse2::ascii_widen_utf16<Swap>(p + i, n - i, dst + i);
+		}
+
+		template <bool Swap>
+		inline FB_COMBY_TARGET("avx2") std::size_t ascii_narrow_utf16(char16_t const* p, std::size_t const n, unsigned char* dst) noexcept {
+			auto const mask = _mm256_set1_epi16(Swap ? static_cast<short>(0x80FF) : static_cast<short>(0xFF80));
+			auto i = std::size_t{};
+
+			for (; i + 32 <= n; i += 32) {
+				auto a = _mm256_loadu_si256(reinterpret_cast<__m256i const*>(p + i));
+				auto b = _mm256_loadu_si256(reinterpret_cast<__m256i const*>(p + i + 16));
+				auto const bad = _mm256_and_si256(_mm256_or_si256(a, b), mask);
+
+				if (!_mm256_testz_si256(bad, bad)) {
+					break;
+				}
+
+				if constexpr(Swap) {
+					a = _mm256_srli_epi16(a, 8);
+					b = _mm256_srli_epi16(b, 8);
+				}
+
+				// packus works within 128 bit lanes, so the quarters come out as a0 b0 a1 b1
+				auto const packed = _mm256_permute4x64_epi64(_mm256_packus_epi16(a, b), 0b11011000);
+				_mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + i), packed);
+			}
+
+			return i + sse2::ascii_narrow_utf16<Swap>(p + i, n - i, dst + i);
+		}
+
+		template <bool Swap>
+		inline FB_COMBY_TARGET("avx2") std::size_t utf16_widen(char16_t const* p, std::size_t const n, char32_t* dst) noexcept {
+			auto const mask = _mm256_set1_epi16(Swap ? 0x00F8 : static_cast<short>(0xF800));
+			auto const surrogate = _mm256_set1_epi16(Swap ? 0x00D8 : static_cast<short>(0xD800));
+			auto const swap = _mm_setr_epi8(1, 0, 3, 2, 5, 4, 7, 6, 9, 8, 11, 10, 13, 12, 15, 14);
+			auto i = std::size_t{};
+
+			for (; i + 16 <= n; i += 16) {
+				auto const v = _mm256_loadu_si256(reinterpret_cast<__m256i const*>(p + i));
+
+				if (_mm256_movemask_epi8(_mm256_cmpeq_epi16(_mm256_and_si256(v, mask), surrogate))) {
+					break;
+				}
+
+				auto lo = _mm256_castsi256_si128(v);
+				auto hi = _mm256_extracti128_si256(v, 1);
+
+				if constexpr(Swap) {
+					lo = _mm_shuffle_epi8(lo, swap);
+					hi = _mm_shuffle_epi8(hi, swap);
+				}
+
+				auto* out = reinterpret_cast<__m256i*>(dst + i);
+
+				_mm256_storeu_si256(out + 0, _mm256_cvtepu16_epi32(lo));
+				_mm256_storeu_si256(out + 1, _mm256_cvtepu16_epi32(hi));
+			}
+
+			return i + ssse3::utf16_widen<Swap>(p + i, n - i, dst + i);
+		}
+
+		template <int N>
+		inline FB_COMBY_TARGET("avx2") __m256i prev(__m256i const input, __m256i const prev_input) noexcept {
+			return _mm256_alignr_epi8(input, _mm256_permute2x128_si256(prev_input, input, 0x21), 16 - N);
+		}
+
+		inline FB_COMBY_TARGET("avx2") __m256i table(std::array<unsigned char, 16> const& t) noexcept {
+			return _mm256_broadcastsi128_si256(_mm_load_si128(reinterpret_cast<__m128i const*>(t.data())));
+		}
+
+		inline FB_COMBY_TARGET("avx2") __m256i utf8_check(__m256i const input, __m256i const prev_input) noexcept {
+			auto const nibble = _mm256_set1_epi8(0x0F);
+			auto const prev1 = prev<1>(input, prev_input);
+			auto const prev2 = prev<2>(input, prev_input);
+			auto const prev3 = prev<3>(input, prev_input);
+
+			auto const byte_1_high = _mm256_shuffle_epi8(table(detail::utf8_byte_1_high),
+								     _mm256_and_si256(_mm256_srli_epi16(prev1, 4), nibble));
+			auto const byte_1_low = _mm256_shuffle_epi8(table(detail::utf8_byte_1_low),
+								    _mm256_and_si256(prev1, nibble));
+			auto const byte_2_high = _mm256_shuffle_epi8(table(detail::utf8_byte_2_high),
+								     _mm256_and_si256(_mm256_srli_epi16(input, 4), nibble));
+
+			auto const special = _mm256_and_si256(_mm256_and_si256(byte_1_high, byte_1_low), byte_2_high);
+			auto const third = _mm256_subs_epu8(prev2, _mm256_set1_epi8(static_cast<char>(0xE0 - 0x80)));
+			auto const fourth = _mm256_subs_epu8(prev3, _mm256_set1_epi8(static_cast<char>(0xF0 - 0x80)));
+			auto const must_continue = _mm256_and_si256(_mm256_or_si256(third, fourth), _mm256_set1_epi8(static_cast<char>(0x80)));
+
+			return _mm256_xor_si256(must_continue, special);
+		}
+
+		inline FB_COMBY_TARGET("avx2") __m256i utf8_incomplete(__m256i const prev_input) noexcept {
+			auto const max = _mm256_setr_epi8(-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+							  -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+							  static_cast<char>(0xF0 - 1),
+							  static_cast<char>(0xE0 - 1),
+							  static_cast<char>(0xC0 - 1));
+
+			return _mm256_subs_epu8(prev_input, max);
+		}
+
+		inline FB_COMBY_TARGET("avx2") std::size_t utf8_valid_prefix(unsigned char const* p, std::size_t const n) noexcept {
+			auto prev = _mm256_setzero_si256();
+			auto i = std::size_t{};
+
+			for (; i + 32 <= n; i += 32) {
+				auto const v = _mm256_loadu_si256(reinterpret_cast<__m256i const*>(p + i));
+				auto const err = _mm256_movemask_epi8(v) ? utf8_check(v, prev) : utf8_incomplete(prev);
+
+				if (!_mm256_testz_si256(err, err)) {
+					break;
+				}
+
+				prev = v;
+			}
+
+			return detail::utf8_boundary(p, i);
+		}
+
+		inline FB_COMBY_TARGET("avx2") std::size_t class_prefix(unsigned char const* p, std::size_t const n, byte_class const& set) noexcept {
+			auto const nibble = _mm256_set1_epi8(0x0F);
+			auto const bit_low = _mm256_setr_epi8(1, 2, 4, 8, 16, 32, 64, -128, 0, 0, 0, 0, 0, 0, 0, 0,
+							      1, 2, 4, 8, 16, 32, 64, -128, 0, 0, 0, 0, 0, 0, 0, 0);
+			auto const bit_high = _mm256_setr_epi8(0, 0, 0, 0, 0, 0, 0, 0, 1, 2, 4, 8, 16, 32, 64, -128,
+							       0, 0, 0, 0, 0, 0, 0, 0, 1, 2, 4, 8, 16, 32, 64, -128);
+			auto const row_low = table(set.row_low);
+			auto const row_high = table(set.row_high);
+			auto i = std::size_t{};
+
+			for (; i + 32 <= n; i += 32) {
+				auto const v = _mm256_loadu_si256(reinterpret_cast<__m256i const*>(p + i));
+				auto const hi = _mm256_and_si256(_mm256_srli_epi16(v, 4), nibble);
+				auto const lo = _mm256_and_si256(v, nibble);
+				auto const low = _mm256_and_si256(_mm256_shuffle_epi8(row_low, hi), _mm256_shuffle_epi8(bit_low, lo));
+				auto const high = _mm256_and_si256(_mm256_shuffle_epi8(row_high, hi), _mm256_shuffle_epi8(bit_high, lo));
+				auto const outside = static_cast<unsigned>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(_mm256_or_si256(low, high), _mm256_setzero_si256())));
+
+				if (outside) {
+					return i + static_cast<std::size_t>(std::countr_zero(outside));
+				}
+			}
+
+			return i + ssse3::class_prefix(p + i, n - i, set);
+		}
+
+		inline FB_COMBY_TARGET("avx2") std::size_t count_byte(unsigned char const* p, std::size_t const n, unsigned char const b) noexcept {
+			auto const needle = _mm256_set1_epi8(static_cast<char>(b));
+			auto total = _mm256_setzero_si256();
+			auto i = std::size_t{};
+
+			while (n - i >= 32) {
+				auto counts = _mm256_setzero_si256();
+
+				for (auto blocks = std::min<std::size_t>((n - i) / 32, 255); blocks; --blocks, i += 32) {
+					counts = _mm256_sub_epi8(counts, _mm256_cmpeq_epi8(_mm256_loadu_si256(reinterpret_cast<__m256i const*>(p + i)), needle));
+				}
+
+				total = _mm256_add_epi64(total, _mm256_sad_epu8(counts, _mm256_setzero_si256()));
+			}
+
+			alignas(32) auto lanes = std::array<std::uint64_t, 4>{};
+			_mm256_store_si256(reinterpret_cast<__m256i*>(lanes.data()), total);
+
+			return static_cast<std::size_t>(lanes[0] + lanes[1] + lanes[2] + lanes[3]) + sse2::count_byte(p + i, n - i, b);
+		}
+	}
+#endif
+
+#if defined(FB_COMBY_SIMD_AVX512)
+	namespace avx512 {
+		inline FB_COMBY_TARGET("avx512f,avx512bw,avx512vl") std::size_t ascii_prefix(unsigned char const* p, std::size_t const n) noexcept {
+			auto i = std::size_t{};
+
+			for (; i + 64 <= n; i += 64) {
+				auto const mask = _mm512_movepi8_mask(_mm512_loadu_si512(p + i));
+
+				if (mask) {
+					return i + static_cast<std::size_t>(std::countr_zero(mask));
+				}
+			}
+
+			return i + avx2::ascii_prefix(p + i, n - i);
+		}
+
+		inline FB_COMBY_TARGET("avx512f,avx512bw,avx512vl") std::size_t ascii_widen(unsigned char const* p, std::size_t const n, char32_t* dst) noexcept {
+			auto i = std::size_t{};
+
+			for (; i + 64 <= n; i += 64) {
+				auto const v = _mm512_loadu_si512(p + i);
+
+				if (_mm512_movepi8_mask(v)) {
+					break;
+				}
+
+				// the maskz forms, GCC 12 warns about the undefined source of the plain ones
+				for (auto j = std::size_t{}; j < 64; j += 16) {
+					auto const part = _mm_loadu_si128(reinterpret_cast<__m128i const*>(p + i + j));
+					_mm512_storeu_si512(dst + i + j, _mm512_maskz_cvtepu8_epi32(0xFFFF, part));
+				}
+			}
+
+			return i + avx2::ascii_widen(p + i, n - i, dst + i);
+		}
+
+		// the high byte of a widened ASCII unit is zero, so swapping it is a shift
+		template <bool Swap>
+		inline FB_COMBY_TARGET("avx512f,avx512bw,avx512vl") std::size_t ascii_widen_utf16(unsigned char const* p, std::size_t const n, char16_t* dst) noexcept {
+			auto i = std::size_t{};
+
+			for (; i + 32 <= n; i += 32) {
+				auto const v = _mm256_loadu_si256(reinterpret_cast<__m256i const*>(p + i));
+
+				if (_mm256_movemask_epi8(v)) {
+					break;
+				}
+
+				auto w = _mm512_maskz_cvtepu8_epi16(~__mmask32{}, v);
+
+				if constexpr(Swap) {
+					w = _mm512_slli_epi16(w, 8);
+				}
+
+				_mm512_storeu_si512(dst + i, w);
+			}
+
+			return i + avx2::ascii_widen_utf16<Swap>(p + i, n - i, dst + i);
+		}
+
+		template <std::size_t N>
+		inline FB_COMBY_TARGET("avx512f,avx512bw,avx512vl") std::size_t bswap(unsigned char const* src, std::size_t const n, unsigned char* dst) noexcept {
+			auto const mask = _mm512_maskz_broadcast_i32x4(0xFFFF, ssse3::bswap_mask<N>());
+			auto i = std::size_t{};
+
+			for (; i + 64 / N <= n; i += 64 / N) {
+				auto const v = _mm512_loadu_si512(src + i * N);
+				_mm512_storeu_si512(dst + i * N, _mm512_shuffle_epi8(v, mask));
+			}
+
+			return i + avx2::bswap<N>(src + i * N, n - i, dst + i * N);
+		}
+
+		inline FB_COMBY_TARGET("avx512f,avx512bw,avx512vl") std::size_t count_byte(unsigned char const* p, std::size_t const n, unsigned char const b) noexcept {
+			auto const needle = _mm512_set1_epi8(static_cast<char>(b));
+			auto total = _mm512_setzero_si512();
+			auto i = std::size_t{};
+
+			while (n - i >= 64) {
+				auto counts = _mm512_setzero_si512();
+
+				for (auto blocks = std::min<std::size_t>((n - i) / 64, 255); blocks; --blocks, i += 64) {
+					counts = _mm512_sub_epi8(counts, _mm512_movm_epi8(_mm512_cmpeq_epi8_mask(_mm512_loadu_si512(p + i), needle)));
+				}
+
+				total = _mm512_add_epi64(total, _mm512_sad_epu8(counts, _mm512_setzero_si512()));
+			}
+
+			alignas(64) auto lanes = std::array<std::uint64_t, 8>{};
+			_mm512_store_si512(lanes.data(), total);
+
+			auto count = std::size_t{};
+
+			for (auto const lane : lanes) {
+				count += static_cast<std::size_t>(lane);
+			}
+
+			return count + avx2::count_byte(p + i, n - i, b);
+		}
+	}
+#endif
+
+	namespace detail {
+		// one level's kernels, the Swap variants are indexed by Swap and bswap by unit size 2, 4, 8
+		struct kernel_table {
+			std::size_t (*ascii_prefix)(unsigned char const*, std::size_t) noexcept;
+			std::size_t (*ascii_widen)(unsigned char const*, std::size_t, char32_t*) noexcept;
+			std::array<std::size_t (*)(unsigned char const*, std::size_t, char16_t*) noexcept, 2> ascii_widen_utf16;
+			std::array<std::size_t (*)(char16_t const*, std::size_t, unsigned char*) noexcept, 2> ascii_narrow_utf16;
+			std::array<std::size_t (*)(char16_t const*, std::size_t, char32_t*) noexcept, 2> utf16_widen;
+			std::size_t (*utf8_valid_prefix)(unsigned char const*, std::size_t) noexcept;
+			std::array<std::size_t (*)(unsigned char const*, std::size_t, unsigned char*) noexcept, 3> bswap;
+			std::size_t (*class_prefix)(unsigned char const*, std::size_t, byte_class const&) noexcept;
+			std::size_t (*count_byte)(unsigned char const*, std::size_t, unsigned char) noexcept;
+		};
+
+		inline constexpr auto scalar_kernels = kernel_table{
+			&swar::ascii_prefix,
+			&swar::ascii_widen<char32_t>,
+			{&swar::ascii_widen_utf16<false>, &swar::ascii_widen_utf16<true>},
+			{&swar::ascii_narrow_utf16<false>, &swar::ascii_narrow_utf16<true>},
+			{&swar::utf16_widen<false>, &swar::utf16_widen<true>},
+			&swar::utf8_valid_prefix,
+			{&swar::bswap<2>, &swar::bswap<4>, &swar::bswap<8>},
+			&swar::class_prefix,
+			&swar::count_byte
+		};
+
+#if defined(__SSE2__)
+		inline constexpr auto sse2_kernels = kernel_table{
+			&sse2::ascii_prefix,
+			&sse2::ascii_widen,
+			{&sse2::ascii_widen_utf16<false>, &sse2::ascii_widen_utf16<true>},
+			{&sse2::ascii_narrow_utf16<false>, &sse2::ascii_narrow_utf16<true>},
+			{&sse2::utf16_widen<false>, &sse2::utf16_widen<true>},
+			&sse2::ascii_prefix,
+			{&sse2::bswap<2>, &sse2::bswap<4>, &sse2::bswap<8>},
+			&swar::class_prefix,
+			&sse2::count_byte
+		};
+#endif
+
+#if defined(FB_COMBY_SIMD_SSSE3)
+		inline constexpr auto sse4_2_kernels = kernel_table{
+			&sse2::ascii_prefix,
+			&sse2::ascii_widen,
+			{&sse2::ascii_widen_utf16<false>, &sse2::ascii_widen_utf16<true>},
+			{&sse2::ascii_narrow_utf16<false>, &sse2::ascii_narrow_utf16<true>},
+			{&ssse3::utf16_widen<false>, &ssse3::utf16_widen<true>},
+			&ssse3::utf8_valid_prefix,
+			{&ssse3::bswap<2>, &ssse3::bswap<4>, &ssse3::bswap<8>},
+			&ssse3::class_prefix,
+			&sse2::count_byte
+		};
+#endif
+
+#if defined(FB_COMBY_SIMD_AVX2)
+		inline constexpr auto avx2_kernels = kernel_table{
+			&avx2::ascii_prefix,
+			&avx2::ascii_widen,
+			{&avx2::ascii_widen_utf16<false>, &avx2::ascii_widen_utf16<true>},
+			{&avx2::ascii_narrow_utf16<false>, &avx2::ascii_narrow_utf16<true>},
+			{&avx2::utf16_widen<false>, &avx2::utf16_widen<true>},
+			&avx2::utf8_valid_prefix,
+			{&avx2::bswap<2>, &avx2::bswap<4>, &avx2::bswap<8>},
+			&avx2::class_prefix,
+			&avx2::count_byte
+		};
+#endif
+
+#if defined(FB_COMBY_SIMD_AVX512)
+		// the UTF-8 validation, UTF-16 and class kernels gain nothing at 512 bits and stay AVX2
+		inline constexpr auto avx512_kernels = kernel_table{
+			&avx512::ascii_prefix,
+			&avx512::ascii_widen,
+			{&avx512::ascii_widen_utf16<false>, &avx512::ascii_widen_utf16<true>},
+			{&avx2::ascii_narrow_utf16<false>, &avx2::ascii_narrow_utf16<true>},
+			{&avx2::utf16_widen<false>, &avx2::utf16_widen<true>},
+			&avx2::utf8_valid_prefix,
+			{&avx512::bswap<2>, &avx512::bswap<4>, &avx512::bswap<8>},
+			&avx2::class_prefix,
+			&avx512::count_byte
+		};
+#endif
+
+		// dispatch::force_level() never goes beyond the supported level, which is always compiled
+		inline kernel_table const& kernels_for(dispatch::level const l) noexcept {
+			switch (l) {
+#if defined(FB_COMBY_SIMD_AVX512)
+				case dispatch::level::AVX512: return avx512_kernels;
+#endif
+#if defined(FB_COMBY_SIMD_AVX2)
+				case dispatch::level::AVX2: return avx2_kernels;
+#endif
+#if defined(FB_COMBY_SIMD_SSSE3)
+				case dispatch::level::SSE4_2: return sse4_2_kernels;
+#endif
+#if defined(__SSE2__)
+				case dispatch::level::SSE2: return sse2_kernels;
+#endif
+				default: return scalar_kernels;
+			}
+		}
+
+		/*
+			a load and a call through the table. the first call looks the table up, and only
+			publishes it if force_level() hasn't set one meanwhile, whose table wins instead.
+		*/
+		inline kernel_table const& kernels() noexcept {
+			auto const* t = dispatch::detail::selected_kernels.load(std::memory_order_relaxed);
+
+			if (!t) [[unlikely]] {
+				auto const* const found = &kernels_for(dispatch::active_level());
+
+				if (dispatch::detail::selected_kernels.compare_exchange_strong(t, found, std::memory_order_relaxed)) {
+					t = found;
+				}
+			}
+
+			return *t;
+		}
+	}
+
+	// the block size utf8_valid_prefix works in, anything it rejects lies within this many bytes
+	inline constexpr std::size_t utf8_block =
+#if defined(FB_COMBY_SIMD_AVX2)
+		32;
+#else
+		16;
+#endif
+
+	inline std::size_t ascii_prefix(unsigned char const* p, std::size_t const n) noexcept {
+		return detail::kernels().ascii_prefix(p, n);
+	}
+
+	inline std::size_t ascii_widen(unsigned char const* p, std::size_t const n, char32_t* dst) noexcept {
+		return detail::kernels().ascii_widen(p, n, dst);
+	}
+
+	/*
+		byte reverses every unit of src into dst, which must be at least as large. src and dst
+		may be the same span but must not otherwise overlap.
+	*/
+	template <concepts::integral I>
+	inline std::span<I> bswap_span(std::span<I const> const src, std::span<I> const dst) noexcept {
+		static_assert(sizeof(I) == 2 || sizeof(I) == 4 || sizeof(I) == 8, "bswap_span only handles 16, 32 and 64 bit units");
+
+		auto i = detail::kernels().bswap[std::countr_zero(sizeof(I)) - 1](reinterpret_cast<unsigned char const*>(src.data()),
+										  src.size(),
+										  reinterpret_cast<unsigned char*>(dst.data()));
+
+		for (; i < src.size(); ++i) {
+			dst[i] = bit::bswap(src[i]);
+		}
+
+		return dst.first(src.size());
+	}
+
+	template <concepts::integral I>
+	inline std::span<I> bswap_span(std::span<I> const data) noexcept {
+		return bswap_span(std::span<I const>{data}, data);
+	}
+
+	template <bool Swap>
+	inline std::size_t ascii_widen_utf16(unsigned char const* p, std::size_t const n, char16_t* dst) noexcept {
+		return detail::kernels().ascii_widen_utf16[Swap](p, n, dst);
+	}
+
+	template <bool Swap>
+	inline std::size_t ascii_narrow_utf16(char16_t const* p, std::size_t const n, unsigned char* dst) noexcept {
+		return detail::kernels().ascii_narrow_utf16[Swap](p, n, dst);
+	}
+
+	template <bool Swap>
+	inline std::size_t utf16_widen(char16_t const* p, std::size_t const n, char32_t* dst) noexcept {
+		return detail::kernels().utf16_widen[Swap](p, n, dst);
+	}
+
+	// length of the longest prefix of p[0, n) whose bytes are all in set
+	inline std::size_t class_prefix(unsigned char const* p, std::size_t const n, byte_class const& set) noexcept {
+		return detail::kernels().class_prefix(p, n, set);
+	}
+
+	// how many bytes of p[0, n) are b
+	inline std::size_t count_byte(unsigned char const* p, std::size_t const n, unsigned char const b) noexcept {
+		return detail::kernels().count_byte(p, n, b);
+	}
+
+	/*
+		length of the longest prefix of p[0, n) known to be well formed UTF-8 and ending on a
+		code point boundary. this is conservative, a short answer only means the caller has
+		to look at the next block itself.
+	*/
+	inline std::size_t utf8_valid_prefix(unsigned char const* p, std::size_t const n) noexcept {
+		return detail::kernels().utf8_valid_prefix(p, n);
+	}
+}
+
+namespace fb::comby::dispatch {
+	// publishes the new level's table itself, a lookup racing with it can't cache the old one
+	inline level force_level(level const l) noexcept {
+		auto const used = std::min(l, supported_level());
+
+		detail::active().store(used, std::memory_order_relaxed);
+		detail::selected_kernels.store(&simd::detail::kernels_for(used), std::memory_order_relaxed);
+		return used;
+	}
+}
+
+#endif
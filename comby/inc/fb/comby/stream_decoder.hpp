@@ -0,0 +1,66 @@
+#ifndef FB_COMBY_STREAM_DECODER_HPP
+#define FB_COMBY_STREAM_DECODER_HPP
+#include <cstddef>
+#include <span>
+#include "fb/comby/encoding.hpp"
+
+namespace fb::comby::encoding {
+	/*
+		decodes input arriving in chunks of any size. a sequence split between two chunks is
+		held in the encoding's state instead of being reported, so only the current chunk and
+		the output buffer need to be kept in memory.
+	*/
+	template <encoding E>
+	class stream_decoder {
+	private:
+		state_t<E> m_state{};
+		bool m_pending = false;
+
+	public:
+		constexpr stream_decoder() = default;
+		constexpr stream_decoder(stream_decoder const&) = default;
+		constexpr stream_decoder(stream_decoder&&) = default;
+
+		constexpr stream_decoder& operator=(stream_decoder const&) = default;
+		constexpr stream_decoder& operator=(stream_decoder&&) = default;
+
+		/*
+			decodes as much of chunk as fits in dst. an incomplete sequence at the end of chunk
+			is consumed and reported as OK, on NOT_ENOUGH_STORAGE feed the rest of the chunk
+			again with more space.
+		*/
+		constexpr decode_result<E> feed(std::span<unit_t<E> const> chunk, std::span<code_t<E>> dst) {
+			if (chunk.empty()) {
+				return {result_code::OK};
+			}
+
+			auto r = decode_all<E>(m_state, chunk, dst);
+
+			if (r.code == result_code::NOT_ENOUGH_INPUT) {
+				m_pending = true;
+				r.code = result_code::OK;
+			} else if (r.code != result_code::NOT_ENOUGH_STORAGE || !r.src.empty()) {
+				m_pending = false;
+			}
+
+			return r;
+		}
+
+		// call once the input has ended, a sequence still waiting for units is INVALID_ENCODING
+		constexpr result_code finish() noexcept {
+			auto const pending = m_pending;
+
+			m_state = {};
+			m_pending = false;
+
+			return pending ? result_code::INVALID_ENCODING : result_code::OK;
+		}
+
+		// whether the last chunk ended in the middle of a sequence
+		constexpr bool pending() const noexcept {
+			return m_pending;
+		}
+	};
+}
+
+#endif
@@ -3,16 +3,27 @@
 #include <cstddef>
 #include <bit>
 #include <span>
+#include <algorithm>
+#include <type_traits>
 #include "fb/comby/encoding.hpp"
 #include "fb/comby/bit.hpp"
+#include "fb/comby/simd.hpp"
+#include "fb/comby/utf8.hpp"
 
 namespace fb::comby::encoding {
 	template <std::endian E, typename U = char16_t>
 	struct base_utf16 {
 		using unit_type = U;
 		using code_type = char32_t;
-		struct state_type {};
 
+		// a high surrogate that ended the previous call
+		struct state_type {
+			char16_t high = 0;
+
+			constexpr bool operator==(state_type const&) const noexcept = default;
+		};
+
+		static constexpr std::endian endian = E;
 		static constexpr std::size_t max_units = 2;
 		static constexpr std::size_t max_codes = 1;
 
@@ -56,7 +67,7 @@ namespace fb::comby::encoding {
 			}
 		}
 
-		static constexpr decode_result<base_utf16> decode(state_type&,
+		static constexpr decode_result<base_utf16> decode(state_type& state,
 								  std::span<unit_type const> src,
 								  std::span<code_type> dst) noexcept
 		{
@@ -66,20 +77,26 @@ namespace fb::comby::encoding {
 				return {result_code::NOT_ENOUGH_STORAGE};
 			}
 
-			auto const u1 = bit::cond_bswap<E>(src[0]);
+			auto const pending = state.high != 0;
+			auto const u1 = pending ? state.high : bit::cond_bswap<E>(src[0]);
+			auto const rest = src.subspan(pending ? 0 : 1);
+
+			state = {};
 
 			if (u1 < 0xD800u) {
 				dst[0] = u1;
 				return {result_code::OK, src.subspan(0, 1), dst.subspan(0, 1)};
 			} else if (u1 <= 0xDBFFu) {
-				if (src.size() < 2) {
-					return {result_code::INVALID_ENCODING, src.subspan(0, 1)};
+				if (rest.empty()) {
+					state.high = static_cast<char16_t>(u1);
+					return {result_code::NOT_ENOUGH_INPUT, src.subspan(0, 1)};
 				}
 
-				auto const u2 = bit::cond_bswap<E>(src[1]);
+				auto const u2 = bit::cond_bswap<E>(rest[0]);
+				auto const n = pending ? 1 : 2;
 
 				if (u2 < 0xDC00u || u2 > 0xDFFFu) {
-					return {result_code::INVALID_ENCODING, src.subspan(0, 2)};
+					return {result_code::INVALID_ENCODING, src.subspan(0, n)};
 				}
 
 				dst[0] = 0x10000
@@ -87,9 +104,9 @@ namespace fb::comby::encoding {
 				       | (u2 - 0xDC00u));
 
 				if (!is_unicode_scalar(dst[0])) {
-					return {result_code::INVALID_CODE_POINT, src.subspan(0, 2), dst.subspan(0, 1)};
+					return {result_code::INVALID_CODE_POINT, src.subspan(0, n), dst.subspan(0, 1)};
 				} else {
-					return {result_code::OK, src.subspan(0, 2), dst.subspan(0, 1)};
+					return {result_code::OK, src.subspan(0, n), dst.subspan(0, 1)};
 				}
 			} else if (u1 <= 0xDFFFu) {
 				return {result_code::INVALID_ENCODING, src.subspan(0, 1)};
@@ -98,6 +115,296 @@ namespace fb::comby::encoding {
 				return {result_code::OK, src.subspan(0, 1), dst.subspan(0, 1)};
 			}
 		}
+
+		/*
+			runs without surrogates are widened in bulk by simd::utf16_widen, decode only sees
+			the surrogate pairs (or strays) that end each run.
+		*/
+		static constexpr decode_result<base_utf16> decode_all(state_type& state,
+								      std::span<unit_type const> src,
+								      std::span<code_type> dst) noexcept
+		{
+			if constexpr(!std::is_same_v<unit_type, char16_t>) {
+				return detail::decode_each<base_utf16>(state, src, dst);
+			} else {
+				if (std::is_constant_evaluated()) {
+					return detail::decode_each<base_utf16>(state, src, dst);
+				}
+
+				auto src_pos = std::size_t{};
+				auto dst_pos = std::size_t{};
+
+				while (src_pos < src.size()) {
+					if (state == state_type{}) {
+						auto const n = simd::utf16_widen<E != std::endian::native>(src.data() + src_pos,
+													   std::min(src.size() - src_pos, dst.size() - dst_pos),
+													   dst.data() + dst_pos);
+
+						src_pos += n;
+						dst_pos += n;
+
+						if (src_pos == src.size()) {
+							break;
+						}
+					}
+
+					auto code = code_type{};
+					auto const saved = state;
+					auto const r = decode(state, src.subspan(src_pos), std::span{&code, 1});
+
+					if (!r) {
+						return {r.code, src.first(src_pos + detail::consumed_by_failure(r)), dst.first(dst_pos)};
+					} else if (dst_pos == dst.size()) {
+						state = saved;
+						return {result_code::NOT_ENOUGH_STORAGE, src.first(src_pos), dst.first(dst_pos)};
+					}
+
+					dst[dst_pos++] = code;
+					src_pos += r.src.size();
+				}
+
+				return {result_code::OK, src.first(src_pos), dst.first(dst_pos)};
+			}
+		}
+
+		/*
+			runs of code points that fit in a single unit are narrowed and then byte swapped in
+			bulk by simd::bswap_span, encode only sees what needs a surrogate pair (or is invalid).
+		*/
+		static constexpr encode_result<base_utf16> encode_all(state_type& state,
+								      std::span<code_type const> src,
+								      std::span<unit_type> dst) noexcept
+		{
+			if constexpr(!std::is_same_v<unit_type, char16_t>) {
+				return detail::encode_each<base_utf16>(state, src, dst);
+			} else {
+				if (std::is_constant_evaluated()) {
+					return detail::encode_each<base_utf16>(state, src, dst);
+				}
+
+				auto src_pos = std::size_t{};
+				auto dst_pos = std::size_t{};
+
+				while (src_pos < src.size()) {
+					auto const in = src.subspan(src_pos, std::min(src.size() - src_pos, dst.size() - dst_pos));
+					auto const n = static_cast<std::size_t>(std::ranges::find_if(in, [](auto const cp) {
+						return !is_unicode_bmp(cp);
+					}) - in.begin());
+
+					for (auto i = std::size_t{}; i < n; ++i) {
+						dst[dst_pos + i] = static_cast<unit_type>(in[i]);
+					}
+
+					if constexpr(E != std::endian::native) {
+						simd::bswap_span(dst.subspan(dst_pos, n));
+					}
+
+					src_pos += n;
+					dst_pos += n;
+
+					if (src_pos == src.size()) {
+						break;
+					}
+
+					auto units = std::array<unit_type, max_units>{};
+					auto const r = encode(state, src.subspan(src_pos), units);
+
+					if (!r) {
+						return {r.code, src.first(src_pos), dst.first(dst_pos)};
+					} else if (dst.size() - dst_pos < r.dst.size()) {
+						return {result_code::NOT_ENOUGH_STORAGE, src.first(src_pos), dst.first(dst_pos)};
+					}
+
+					std::ranges::copy(r.dst, dst.begin() + dst_pos);
+					src_pos += r.src.size();
+					dst_pos += r.dst.size();
+				}
+
+				return {result_code::OK, src.first(src_pos), dst.first(dst_pos)};
+			}
+		}
+	};
+
+	/*
+		UTF-8 <-> UTF-16 without going through char32_t. ASCII runs are widened or narrowed in
+		bulk and everything else is converted a sequence at a time, giving the same results as
+		pivoting through decode_all and encode_all.
+	*/
+	template <typename U, std::endian E>
+	struct transcoder<base_utf8<U>, base_utf16<E, char16_t>> {
+		using from_type = base_utf8<U>;
+		using to_type = base_utf16<E, char16_t>;
+
+		static constexpr bool swap = E != std::endian::native;
+
+		// returns the number of units written for u8 already known to be well formed
+		static std::size_t convert_valid(unsigned char const* src, std::size_t const n, char16_t* dst) noexcept {
+			auto i = std::size_t{};
+			auto j = std::size_t{};
+
+			while (i < n) {
+				auto const k = simd::ascii_widen_utf16<swap>(src + i, n - i, dst + j);
+				i += k;
+				j += k;
+
+				while (i < n && src[i] >= 0x80u) {
+					auto const b = src[i];
+
+					if (b < 0xE0u) {
+						dst[j++] = bit::cond_bswap<E>(static_cast<char16_t>(((b & 0x1Fu) << 6)
+												   | (src[i + 1] & 0x3Fu)));
+						i += 2;
+					} else if (b < 0xF0u) {
+						dst[j++] = bit::cond_bswap<E>(static_cast<char16_t>(((b & 0x0Fu) << 12)
+												   | ((src[i + 1] & 0x3Fu) << 6)
+												   | (src[i + 2] & 0x3Fu)));
+						i += 3;
+					} else {
+						auto const cp = ((b & 0x07u) << 18)
+							      | ((src[i + 1] & 0x3Fu) << 12)
+							      | ((src[i + 2] & 0x3Fu) << 6)
+							      | (src[i + 3] & 0x3Fu);
+
+						dst[j++] = bit::cond_bswap<E>(static_cast<char16_t>(((cp - 0x10000u) >> 10) + 0xD800u));
+						dst[j++] = bit::cond_bswap<E>(static_cast<char16_t>((cp & 0x3FFu) + 0xDC00u));
+						i += 4;
+					}
+				}
+			}
+
+			return j;
+		}
+
+		static constexpr transcode_result<from_type, to_type> transcode(state_t<from_type>& from,
+										state_t<to_type>& to,
+										std::span<U const> src,
+										std::span<char16_t> dst) noexcept
+		{
+			if (std::is_constant_evaluated()) {
+				return detail::transcode_pivot<from_type, to_type>(from, to, src, dst);
+			}
+
+			auto const* units = reinterpret_cast<unsigned char const*>(src.data());
+			auto src_pos = std::size_t{};
+			auto dst_pos = std::size_t{};
+
+			while (src_pos < src.size()) {
+				// a valid prefix never needs more UTF-16 units than it has bytes
+				if (from == state_t<from_type>{}) {
+					auto const valid = simd::utf8_valid_prefix(units + src_pos, std::min(src.size() - src_pos, dst.size() - dst_pos));
+
+					dst_pos += convert_valid(units + src_pos, valid, dst.data() + dst_pos);
+					src_pos += valid;
+				}
+
+				for (auto const stop = std::min(src.size(), src_pos + 2 * simd::utf8_block); src_pos < stop;) {
+					auto code = char32_t{};
+					auto const saved = from;
+					auto const r = from_type::decode(from, src.subspan(src_pos), std::span{&code, 1});
+
+					if (!r) {
+						return {r.code, src.first(src_pos + detail::consumed_by_failure(r)), dst.first(dst_pos)};
+					} else if (dst.size() - dst_pos < (code < 0x10000u ? 1u : 2u)) {
+						from = saved;
+						return {result_code::NOT_ENOUGH_STORAGE, src.first(src_pos), dst.first(dst_pos)};
+					}
+
+					if (code < 0x10000u) {
+						dst[dst_pos++] = bit::cond_bswap<E>(static_cast<char16_t>(code));
+					} else {
+						dst[dst_pos++] = bit::cond_bswap<E>(static_cast<char16_t>(((code - 0x10000u) >> 10) + 0xD800u));
+						dst[dst_pos++] = bit::cond_bswap<E>(static_cast<char16_t>((code & 0x3FFu) + 0xDC00u));
+					}
+
+					src_pos += r.src.size();
+				}
+			}
+
+			return {result_code::OK, src.first(src_pos), dst.first(dst_pos)};
+		}
+	};
+
+	template <std::endian E, typename U>
+	struct transcoder<base_utf16<E, char16_t>, base_utf8<U>> {
+		using from_type = base_utf16<E, char16_t>;
+		using to_type = base_utf8<U>;
+
+		static constexpr bool swap = E != std::endian::native;
+
+		static constexpr transcode_result<from_type, to_type> transcode(state_t<from_type>& from,
+										state_t<to_type>& to,
+										std::span<char16_t const> src,
+										std::span<U> dst) noexcept
+		{
+			if (std::is_constant_evaluated()) {
+				return detail::transcode_pivot<from_type, to_type>(from, to, src, dst);
+			}
+
+			auto* out = reinterpret_cast<unsigned char*>(dst.data());
+			auto src_pos = std::size_t{};
+			auto dst_pos = std::size_t{};
+
+			while (src_pos < src.size()) {
+				auto const k = simd::ascii_narrow_utf16<swap>(src.data() + src_pos,
+									      std::min(src.size() - src_pos, dst.size() - dst_pos),
+									      out + dst_pos);
+
+				src_pos += k;
+				dst_pos += k;
+
+				while (src_pos < src.size()) {
+					auto const u1 = bit::cond_bswap<E>(src[src_pos]);
+					auto const saved = from;
+					auto cp = static_cast<char32_t>(u1);
+					auto n = std::size_t{1};
+
+					if (u1 < 0x80u && from == state_t<from_type>{}) {
+						if (dst_pos == dst.size()) {
+							return {result_code::NOT_ENOUGH_STORAGE, src.first(src_pos), dst.first(dst_pos)};
+						}
+
+						break;
+					} else if ((u1 >= 0xD800u && u1 <= 0xDFFFu) || from != state_t<from_type>{}) {
+						// surrogates, and a pair split across calls, go through decode
+						auto const r = from_type::decode(from, src.subspan(src_pos), std::span{&cp, 1});
+
+						if (!r) {
+							return {r.code, src.first(src_pos + detail::consumed_by_failure(r)), dst.first(dst_pos)};
+						}
+
+						n = r.src.size();
+					}
+
+					auto const bytes = cp < 0x800u ? 2u : cp < 0x10000u ? 3u : 4u;
+
+					if (dst.size() - dst_pos < bytes) {
+						from = saved;
+						return {result_code::NOT_ENOUGH_STORAGE, src.first(src_pos), dst.first(dst_pos)};
+					}
+
+					auto* o = out + dst_pos;
+
+					if (bytes == 2) {
+						o[0] = static_cast<unsigned char>(0b11000000u | (cp >> 6));
+						o[1] = static_cast<unsigned char>(0b10000000u | (cp & 0x3Fu));
+					} else if (bytes == 3) {
+						o[0] = static_cast<unsigned char>(0b11100000u | (cp >> 12));
+						o[1] = static_cast<unsigned char>(0b10000000u | ((cp >> 6) & 0x3Fu));
+						o[2] = static_cast<unsigned char>(0b10000000u | (cp & 0x3Fu));
+					} else {
+						o[0] = static_cast<unsigned char>(0b11110000u | (cp >> 18));
+						o[1] = static_cast<unsigned char>(0b10000000u | ((cp >> 12) & 0x3Fu));
+						o[2] = static_cast<unsigned char>(0b10000000u | ((cp >> 6) & 0x3Fu));
+						o[3] = static_cast<unsigned char>(0b10000000u | (cp & 0x3Fu));
+					}
+
+					src_pos += n;
+					dst_pos += bytes;
+				}
+			}
+
+			return {result_code::OK, src.first(src_pos), dst.first(dst_pos)};
+		}
 	};
 
 	using utf16_le = base_utf16<std::endian::little>;
@@ -1,8 +1,12 @@
 #ifndef FB_COMBY_ENCODING_UTF32_HPP
 #define FB_COMBY_ENCODING_UTF32_HPP
 #include <cstddef>
+#include <algorithm>
+#include <span>
+#include <type_traits>
 #include "fb/comby/encoding.hpp"
 #include "fb/comby/bit.hpp"
+#include "fb/comby/simd.hpp"
 
 namespace fb::comby::encoding {
 	template <std::endian E>
@@ -11,6 +15,7 @@ namespace fb::comby::encoding {
 		using code_type = char32_t;
 		struct state_type {};
 
+		static constexpr std::endian endian = E;
 		static constexpr std::size_t max_units = 1;
 		static constexpr std::size_t max_codes = 1;
 
@@ -45,6 +50,78 @@ namespace fb::comby::encoding {
 				return {result_code::OK, src.subspan(0, 1), dst.subspan(0, 1)};
 			}
 		}
+
+	private:
+		static constexpr std::size_t block = 1024;
+
+		// copies src to dst in the target byte order, returns the index of the first invalid code point
+		static std::size_t convert_block(std::span<char32_t const> src, std::span<char32_t> dst, std::span<char32_t const> codes) noexcept {
+			if constexpr(E != std::endian::native) {
+				simd::bswap_span(src, dst);
+			} else {
+				std::ranges::copy(src, dst.begin());
+			}
+
+			auto invalid = false;
+
+			for (auto const cp : codes) {
+				invalid |= !is_unicode_scalar(cp);
+			}
+
+			if (!invalid) {
+				return src.size();
+			}
+
+			return static_cast<std::size_t>(std::ranges::find_if(codes, [](auto const cp) {
+				return !is_unicode_scalar(cp);
+			}) - codes.begin());
+		}
+
+		template <typename R, bool Decode>
+		static R convert_all(std::span<char32_t const> src, std::span<char32_t> dst, result_code const error) noexcept {
+			auto const n = std::min(src.size(), dst.size());
+
+			for (auto i = std::size_t{}; i < n; i += block) {
+				auto const in = src.subspan(i, std::min(block, n - i));
+				auto const out = dst.subspan(i, in.size());
+				auto const bad = convert_block(in, out, Decode ? std::span<char32_t const>{out} : in);
+
+				if (bad < in.size()) {
+					return {error, src.first(i + bad), dst.first(i + bad)};
+				}
+			}
+
+			if (n < src.size()) {
+				auto const valid = is_unicode_scalar(Decode ? bit::cond_bswap<E>(src[n]) : src[n]);
+				return {valid ? result_code::NOT_ENOUGH_STORAGE : error, src.first(n), dst.first(n)};
+			}
+
+			return {result_code::OK, src, dst.first(n)};
+		}
+
+	public:
+		// byte order is reversed in bulk and code points are checked a block at a time
+		static constexpr decode_result<base_utf32> decode_all(state_type& state,
+								      std::span<unit_type const> src,
+								      std::span<code_type> dst) noexcept
+		{
+			if (std::is_constant_evaluated()) {
+				return detail::decode_each<base_utf32>(state, src, dst);
+			}
+
+			return convert_all<decode_result<base_utf32>, true>(src, dst, result_code::INVALID_ENCODING);
+		}
+
+		static constexpr encode_result<base_utf32> encode_all(state_type& state,
+								      std::span<code_type const> src,
+								      std::span<unit_type> dst) noexcept
+		{
+			if (std::is_constant_evaluated()) {
+				return detail::encode_each<base_utf32>(state, src, dst);
+			}
+
+			return convert_all<encode_result<base_utf32>, false>(src, dst, result_code::INVALID_CODE_POINT);
+		}
 	};
 
 	using utf32_le = base_utf32<std::endian::little>;
@@ -1,10 +1,13 @@
 #ifndef FB_COMBY_UTF8_ENCODING_HPP
 #define FB_COMBY_UTF8_ENCODING_HPP
 #include <cstddef>
+#include <cstdint>
 #include <ranges>
 #include <algorithm>
 #include <span>
+#include <type_traits>
 #include "fb/comby/encoding.hpp"
+#include "fb/comby/simd.hpp"
 
 namespace fb::comby::encoding {
 	template <typename U>
@@ -12,7 +15,14 @@ namespace fb::comby::encoding {
 	public:
 		using unit_type = U;
 		using code_type = char32_t;
-		struct state_type {};
+
+		// the bits decoded so far of a sequence split across calls
+		struct state_type {
+			code_type code = 0;
+			std::uint8_t remaining = 0;
+
+			constexpr bool operator==(state_type const&) const noexcept = default;
+		};
 
 		static constexpr std::size_t max_units = 4;
 		static constexpr std::size_t max_codes = 1;
@@ -32,7 +42,7 @@ namespace fb::comby::encoding {
 			auto arr = std::array<unit_class, 256>{};
 
 			for (auto i = std::size_t{}; i < std::ranges::size(arr); ++i) {
-				auto j = static_cast<unit_t<base_utf8>>(i);
+				auto const j = static_cast<unsigned char>(i);
 
 				if (j < 0x80) {
 					arr[i] = unit_class::LB_1;
@@ -69,6 +79,43 @@ namespace fb::comby::encoding {
 			   ERROR,   ERROR, DONE,  ERROR, ERROR, ERROR  // _1
 		};
 
+		// decodes units already known to be well formed, see simd::utf8_valid_prefix
+		static std::size_t decode_valid(unsigned char const* src, std::size_t const n, code_type* dst) noexcept {
+			auto i = std::size_t{};
+			auto j = std::size_t{};
+
+			while (i < n) {
+				auto const k = simd::ascii_widen(src + i, n - i, dst + j);
+				i += k;
+				j += k;
+
+				while (i < n && src[i] >= 0x80u) {
+					auto const b = src[i];
+
+					if (b < 0xE0u) {
+						dst[j] = (static_cast<code_type>(b & 0x1Fu) << 6)
+						       | static_cast<code_type>(src[i + 1] & 0x3Fu);
+						i += 2;
+					} else if (b < 0xF0u) {
+						dst[j] = (static_cast<code_type>(b & 0x0Fu) << 12)
+						       | (static_cast<code_type>(src[i + 1] & 0x3Fu) << 6)
+						       | static_cast<code_type>(src[i + 2] & 0x3Fu);
+						i += 3;
+					} else {
+						dst[j] = (static_cast<code_type>(b & 0x07u) << 18)
+						       | (static_cast<code_type>(src[i + 1] & 0x3Fu) << 12)
+						       | (static_cast<code_type>(src[i + 2] & 0x3Fu) << 6)
+						       | static_cast<code_type>(src[i + 3] & 0x3Fu);
+						i += 4;
+					}
+
+					++j;
+				}
+			}
+
+			return j;
+		}
+
 	public:
 		constexpr base_utf8() = default;
 		constexpr base_utf8(base_utf8 const&) = default;
@@ -116,7 +163,7 @@ namespace fb::comby::encoding {
 			}
 		}
 
-		static constexpr decode_result<base_utf8> decode(state_type&,
+		static constexpr decode_result<base_utf8> decode(state_type& state,
 								 std::span<unit_type const> src,
 								 std::span<code_type> dst) noexcept
 		{
@@ -124,17 +171,19 @@ namespace fb::comby::encoding {
 				return {result_code::OK};
 			}
 
-			auto s = decode_state::DONE;
+			auto s = static_cast<decode_state>(state.remaining);
+			auto code = state.code;
 			auto src_pos = std::ranges::begin(src);
 			auto src_end = std::ranges::end(src);
 
 			do {
-				auto const c = unit_to_class[*src_pos];
+				auto const u = static_cast<unsigned char>(*src_pos);
+				auto const c = unit_to_class[u];
 
 				if (s == decode_state::DONE) {
-					dst[0] = (0xFF >> c) & *src_pos;
+					code = (0xFFu >> c) & u;
 				} else {
-					dst[0] = (dst[0] << 6) | static_cast<code_type>(*src_pos & 0x3F);
+					code = (code << 6) | static_cast<code_type>(u & 0x3Fu);
 				}
 
 				s = class_to_state[static_cast<unit_type>(unit_class::_MAX)
@@ -146,16 +195,99 @@ namespace fb::comby::encoding {
 			     && s != decode_state::DONE
 			     && s != decode_state::ERROR);
 
+			auto const consumed = src.subspan(0, src_pos - std::ranges::begin(src));
+
+			state = {};
+
 			if (s == decode_state::DONE) {
-				if (is_unicode_scalar(dst[0])) {
-					return {result_code::OK, src.subspan(0, src_end - src_pos), dst.subspan(0, 1)};
+				dst[0] = code;
+
+				if (is_unicode_scalar(code)) {
+					return {result_code::OK, consumed, dst.subspan(0, 1)};
 				} else {
-					return {result_code::INVALID_CODE_POINT, src.subspan(0, src_end - src_pos), dst.subspan(0, 1)};
+					return {result_code::INVALID_CODE_POINT, consumed, dst.subspan(0, 1)};
 				}
+			} else if (s == decode_state::ERROR) {
+				return {result_code::INVALID_ENCODING, consumed};
 			} else {
-				return {result_code::INVALID_ENCODING, src.subspan(0, src_end - src_pos)};
+				state = {code, static_cast<std::uint8_t>(s)};
+				return {result_code::NOT_ENOUGH_INPUT, consumed};
 			}
 		}
+
+		/*
+			well formed blocks are found with simd::utf8_valid_prefix and decoded without any
+			checks. whatever it rejects, including the overlong forms decode accepts, is run
+			through decode so the result codes are exactly those of the DFA.
+		*/
+		static constexpr decode_result<base_utf8> decode_all(state_type& state,
+								     std::span<unit_type const> src,
+								     std::span<code_type> dst) noexcept
+		{
+			if (std::is_constant_evaluated()) {
+				return detail::decode_each<base_utf8>(state, src, dst);
+			}
+
+			auto const* units = reinterpret_cast<unsigned char const*>(src.data());
+			auto src_pos = std::size_t{};
+			auto dst_pos = std::size_t{};
+
+			while (src_pos < src.size()) {
+				// a valid prefix never decodes to more code points than it has units
+				if (state == state_type{}) {
+					auto const valid = simd::utf8_valid_prefix(units + src_pos, std::min(src.size() - src_pos, dst.size() - dst_pos));
+
+					dst_pos += decode_valid(units + src_pos, valid, dst.data() + dst_pos);
+					src_pos += valid;
+				}
+
+				for (auto const stop = std::min(src.size(), src_pos + 2 * simd::utf8_block); src_pos < stop;) {
+					auto code = code_type{};
+					auto const saved = state;
+					auto const r = decode(state, src.subspan(src_pos), std::span{&code, 1});
+
+					if (!r) {
+						return {r.code, src.first(src_pos + detail::consumed_by_failure(r)), dst.first(dst_pos)};
+					} else if (dst_pos == dst.size()) {
+						state = saved;
+						return {result_code::NOT_ENOUGH_STORAGE, src.first(src_pos), dst.first(dst_pos)};
+					}
+
+					dst[dst_pos++] = code;
+					src_pos += r.src.size();
+				}
+			}
+
+			return {result_code::OK, src.first(src_pos), dst.first(dst_pos)};
+		}
+
+		/*
+			returns OK with the whole of src, or the result of decoding the first sequence that
+			is not a valid code point with src ending right before it (or after it, for a
+			sequence left incomplete in the state).
+		*/
+		static constexpr decode_result<base_utf8> validate(state_type& state, std::span<unit_type const> src) noexcept {
+			auto code = code_type{};
+			auto src_pos = std::size_t{};
+
+			while (src_pos < src.size()) {
+				if (!std::is_constant_evaluated() && state == state_type{}) {
+					src_pos += simd::utf8_valid_prefix(reinterpret_cast<unsigned char const*>(src.data()) + src_pos, src.size() - src_pos);
+				}
+
+				for (auto const stop = std::min(src.size(), src_pos + 2 * simd::utf8_block); src_pos < stop;) {
+					auto const r = decode(state, src.subspan(src_pos), std::span{&code, 1});
+
+					if (!r) {
+						return {r.code, src.first(src_pos + detail::consumed_by_failure(r))};
+					}
+
+					src_pos += r.src.size();
+				}
+			}
+
+			return {result_code::OK, src};
+		}
 	};
 
 	using utf8 = base_utf8<char8_t>;
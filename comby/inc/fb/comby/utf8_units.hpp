@@ -0,0 +1,239 @@
+#ifndef FB_COMBY_UTF8_UNITS_HPP
+#define FB_COMBY_UTF8_UNITS_HPP
+#include <cstddef>
+#include <cstdint>
+#include <array>
+#include <iterator>
+#include <memory>
+#include <span>
+#include <string_view>
+#include <type_traits>
+#include <utility>
+#include <variant>
+#include "fb/tag_invoke.hpp"
+#include "fb/comby/concepts.hpp"
+#include "fb/comby/parser.hpp"
+#include "fb/comby/first_set.hpp"
+#include "fb/comby/char_class.hpp"
+#include "fb/comby/simd.hpp"
+#include "fb/comby/utf8.hpp"
+#include "fb/comby/decode_view.hpp"
+
+/*
+	parsing UTF-8 without decoding it first. the parsers here take raw char8_t units, as do
+	literal<u8"..."> and the char8_t take_while over ASCII classes, and only decode where a
+	code point above 0x7F could matter.
+
+	whatever they consume is well formed UTF-8: ASCII bytes are matched against ASCII only,
+	anything else is decoded and checked a code point at a time or, for utf8_decoded,
+	validated once the rule inside it has finished.
+*/
+namespace fb::comby {
+	namespace detail {
+		// the ASCII members of Class, which raw units are classified by
+		template <auto Class>
+		inline constexpr auto ascii_byte_class = simd::byte_class{{Class.bytes[0], Class.bytes[1], 0, 0}};
+
+		template <auto Class>
+		inline constexpr bool has_non_ascii = Class.bytes[2] || Class.bytes[3] || Class.contains_wide();
+
+		// the bytes a code point can start with, for the code points f allows
+		constexpr first_set utf8_first(first_set const& f) noexcept {
+			auto set = first_set{{f.bytes[0], f.bytes[1], 0, 0}, false, f.nullable};
+
+			if (f.bytes[2] || f.bytes[3] || f.wide) {
+				for (auto c = char32_t{0xC2}; c <= 0xF4; ++c) {
+					set.add(c);
+				}
+			}
+
+			return set;
+		}
+
+		// the code point at p, 0 units if there is none or it is malformed
+		inline std::pair<char32_t, std::size_t> utf8_code_at(char8_t const* p, std::size_t const left) noexcept {
+			auto state = encoding::state_t<encoding::utf8>{};
+			auto code = char32_t{};
+			auto const r = encoding::utf8::decode(state, std::span<char8_t const>{p, std::min<std::size_t>(left, 4)}, std::span{&code, 1});
+			auto const len = r.src.size();
+
+			// utf8::decode lets overlong forms through, they are malformed all the same
+			if (!r || len != 1u + (code >= 0x80) + (code >= 0x800) + (code >= 0x10000)) {
+				return {0, 0};
+			}
+
+			return {code, len};
+		}
+
+		// the length of the well formed prefix of p[0, n)
+		inline std::size_t utf8_well_formed(char8_t const* p, std::size_t const n) noexcept {
+			auto i = simd::utf8_valid_prefix(reinterpret_cast<unsigned char const*>(p), n);
+
+			while (i < n) {
+				if (p[i] < 0x80) {
+					++i;
+					continue;
+				}
+
+				auto const len = utf8_code_at(p + i, n - i).second;
+
+				if (!len) {
+					break;
+				}
+
+				i += len;
+			}
+
+			return i;
+		}
+
+		// how many units from p on are code points in Class, counting the code points in count
+		template <auto Class>
+		std::size_t utf8_class_run(char8_t const* p, std::size_t const n, std::size_t& count) noexcept {
+			auto i = std::size_t{};
+
+			while (true) {
+				auto const ascii = simd::class_prefix(reinterpret_cast<unsigned char const*>(p + i), n - i, ascii_byte_class<Class>);
+
+				i += ascii;
+				count += ascii;
+
+				if constexpr(!has_non_ascii<Class>) {
+					return i;
+				}
+
+				if (i == n || p[i] < 0x80) {
+					return i;
+				}
+
+				auto const [code, len] = utf8_code_at(p + i, n - i);
+
+				if (!len || !Class.contains(code)) {
+					return i;
+				}
+
+				i += len;
+				++count;
+			}
+		}
+	}
+
+	// one code point of Class
+	template <auto Class, typename E = std::monostate>
+	class utf8_one_of_parser {
+	public:
+		using char_type = char8_t;
+		using value_type = char32_t;
+		using error_type = E;
+
+		static constexpr first_set first = detail::utf8_first(Class.first());
+
+		template <detail::contiguous_units<char8_t> It, std::sized_sentinel_for<It> S>
+		friend parser_result<char_type, value_type, error_type, It, S> tag_invoke(fb::tag_t<parse>, utf8_one_of_parser const&, It pos, S end) {
+			auto r = parser_result<char_type, value_type, error_type, It, S>{default_result, pos};
+
+			if (pos == end) {
+				return r;
+			} else if (*pos < 0x80) {
+				if (Class.contains(*pos)) {
+					r.set_value(*pos, pos + 1);
+				}
+			} else if constexpr(detail::has_non_ascii<Class>) {
+				auto const [code, len] = detail::utf8_code_at(std::to_address(pos), static_cast<std::size_t>(end - pos));
+
+				if (len && Class.contains(code)) {
+					r.set_value(code, pos + static_cast<std::iter_difference_t<It>>(len));
+				}
+			}
+
+			return r;
+		}
+	};
+
+	/*
+		the longest run of at least Min code points of Class, as units. ASCII is classified
+		in bulk straight from the units and only a byte above 0x7F stops to decode, when
+		Class has anything there to match.
+	*/
+	template <auto Class, std::size_t Min = 0, typename E = std::monostate>
+	class utf8_take_while_parser {
+	public:
+		using char_type = char8_t;
+		using value_type = std::u8string_view;
+		using error_type = E;
+
+		static constexpr first_set first = Min ? detail::utf8_first(Class.first()) : detail::utf8_first(Class.first()) | first_set::empty_match();
+
+		template <detail::contiguous_units<char8_t> It, std::sized_sentinel_for<It> S>
+		friend parser_result<char_type, value_type, error_type, It, S> tag_invoke(fb::tag_t<parse>, utf8_take_while_parser const&, It pos, S end) {
+			auto r = parser_result<char_type, value_type, error_type, It, S>{default_result, pos};
+			auto count = std::size_t{};
+			auto const* p = std::to_address(pos);
+			auto const n = detail::utf8_class_run<Class>(p, static_cast<std::size_t>(end - pos), count);
+
+			if (count >= Min) {
+				r.set_value(value_type{p, n}, pos + static_cast<std::iter_difference_t<It>>(n));
+			}
+
+			return r;
+		}
+	};
+
+	/*
+		runs P, a parser of code points, over the units decoded on the fly. the units it
+		consumed are validated afterwards, so a replacement character standing in for bad
+		input fails it at the offending unit with a default constructed error.
+	*/
+	template <typename P>
+	requires concepts::same_as<parser_char_t<P>, char32_t>
+	class utf8_decoded_parser {
+	public:
+		using char_type = char8_t;
+		using value_type = parser_value_t<P>;
+		using error_type = parser_error_t<P>;
+		using parser_type = P;
+
+		static constexpr first_set first = detail::utf8_first(first_set_v<P>);
+
+	private:
+		parser_type m_p;
+
+	public:
+		explicit constexpr utf8_decoded_parser(parser_type p) :
+			m_p{std::move(p)}
+		{}
+
+		template <typename Self, detail::contiguous_units<char8_t> It, std::sized_sentinel_for<It> S, typename... Cs>
+		requires concepts::same_as<std::remove_const_t<Self>, utf8_decoded_parser> && (sizeof...(Cs) <= 1)
+		friend parser_result<char_type, value_type, error_type, It, S> tag_invoke(fb::tag_t<parse>, Self& p, It pos, S end, Cs&... ctx) {
+			auto r = parser_result<char_type, value_type, error_type, It, S>{default_result, pos};
+			auto const units = std::u8string_view{std::to_address(pos), static_cast<std::size_t>(end - pos)};
+			auto const view = units | encoding::views::decode<encoding::utf8>;
+			auto inner = parse(p.m_p, view.begin(), view.end(), ctx...);
+			auto const consumed = static_cast<std::size_t>(inner.pos().base() - units.begin());
+
+			if (auto const valid = detail::utf8_well_formed(units.data(), consumed); valid != consumed) {
+				r.set_error(error_type{}, pos + static_cast<std::iter_difference_t<It>>(valid));
+			} else if (inner.index() == 1) {
+				r.set_value(std::move(inner.value()), pos + static_cast<std::iter_difference_t<It>>(consumed));
+			} else {
+				r.set_error(std::move(inner.error()), pos + static_cast<std::iter_difference_t<It>>(consumed));
+			}
+
+			return r;
+		}
+	};
+
+	template <auto Class, typename E = std::monostate>
+	inline constexpr utf8_one_of_parser<Class, E> utf8_one_of = {};
+
+	template <auto Class, std::size_t Min = 0, typename E = std::monostate>
+	inline constexpr utf8_take_while_parser<Class, Min, E> utf8_take_while = {};
+
+	template <typename P>
+	constexpr utf8_decoded_parser<std::remove_cvref_t<P>> utf8_decoded(P&& p) {
+		return utf8_decoded_parser<std::remove_cvref_t<P>>{std::forward<P>(p)};
+	}
+}
+
+#endif
@@ -1,4 +1,5 @@
 #include <cassert>
+#include <clocale>
 #include <cstddef>
 #include <utility>
 #include <functional>
@@ -6,12 +7,20 @@
 #include <tuple>
 #include <array>
 #include <string_view>
+#include <vector>
+#include <list>
 #include "fb/comby/encoding.hpp"
 #include "fb/comby/ascii.hpp"
 #include "fb/comby/utf8.hpp"
 #include "fb/comby/utf16.hpp"
 #include "fb/comby/utf32.hpp"
 #include "fb/comby/locale.hpp"
+#include "fb/comby/bit.hpp"
+#include "fb/comby/simd.hpp"
+#include "fb/comby/dispatch.hpp"
+#include "fb/comby/decode_view.hpp"
+#include "fb/comby/stream_decoder.hpp"
+#include "fb/comby/parser.hpp"
 
 using namespace std::literals;
 using namespace fb::comby::encoding;
@@ -139,10 +148,480 @@ void test_utf32() noexcept {
 
 }
 
+void test_bulk() noexcept {
+	auto const text = u8"a\u0400b\uFFFD\U0010AAAA"sv;
+	auto codes = std::array<char32_t, 8>{};
+	auto u8_state = state_t<utf8>{};
+
+	auto const d = decode_all<utf8>(u8_state, text, codes);
+	assert(d);
+	assert(d.src.size() == text.size());
+	assert(std::u32string_view(d.dst.data(), d.dst.size()) == U"a\u0400b\uFFFD\U0010AAAA"sv);
+
+	auto units = std::array<char8_t, 16>{};
+	auto const e = encode_all<utf8>(u8_state, d.dst, units);
+	assert(e);
+	assert(std::u8string_view(e.dst.data(), e.dst.size()) == text);
+
+	// the fallback stops before a code point that would not fit
+	auto const short_e = encode_all<utf8>(u8_state, d.dst, std::span{units}.first(4));
+	assert(short_e.code == result_code::NOT_ENOUGH_STORAGE);
+	assert(short_e.src.size() == 3 && short_e.dst.size() == 4);
+
+	auto const broken = std::array<char8_t, 5>{u8'a', u8'b', 0b11000011u, u8'c', u8'd'};
+	auto const bad = decode_all<utf8>(u8_state, broken, codes);
+	assert(bad.code == result_code::INVALID_ENCODING);
+	assert(bad.src.size() == 2 && bad.dst.size() == 2);
+
+	auto u16_state = state_t<utf16>{};
+	auto u16_units = std::array<char16_t, 8>{};
+	auto const t = transcode<utf8, utf16>(u8_state, u16_state, text, u16_units);
+	assert(t);
+	assert(t.src.size() == text.size());
+	assert(std::u16string_view(t.dst.data(), t.dst.size()) == u"a\u0400b\uFFFD\U0010AAAA"sv);
+
+	auto ascii_state = state_t<ascii>{};
+	auto ascii_units = std::array<char, 8>{};
+	auto const narrowed = transcode<utf8, ascii>(u8_state, ascii_state, text, ascii_units);
+	assert(narrowed.code == result_code::INVALID_CODE_POINT);
+	assert(narrowed.src.size() == 1 && narrowed.dst.size() == 1);
+}
+
+// mostly ASCII with every kind of multi byte, malformed and overlong sequence sprinkled in
+std::vector<char8_t> random_utf8(std::size_t const n, std::uint32_t seed) {
+	static constexpr auto pieces = std::array{
+		u8"\u00E9"sv, u8"\u0400"sv, u8"\u4E2D"sv, u8"\uFFFD"sv, u8"\U0001F600"sv, u8"\U0010FFFF"sv,
+		u8"\xC0\x80"sv, u8"\xE0\x80\x80"sv, u8"\xF0\x80\x80\x80"sv, u8"\xED\xA0\x80"sv,
+		u8"\xF4\x90\x80\x80"sv, u8"\xF7\xBF\xBF\xBF"sv, u8"\xF8"sv, u8"\x80"sv, u8"\xE4\xB8"sv
+	};
+
+	auto out = std::vector<char8_t>{};
+	auto const next = [&] {
+		seed = seed * 1664525u + 1013904223u;
+		return seed >> 8;
+	};
+
+	while (out.size() < n) {
+		auto const r = next();
+
+		if (r % 64) {
+			out.push_back(static_cast<char8_t>(0x20 + r % 0x5F));
+		} else {
+			auto const piece = pieces[(r >> 6) % (r & 0x1000 ? pieces.size() : 6)];
+			out.insert(out.end(), piece.begin(), piece.end());
+		}
+	}
+
+	return out;
+}
+
+void test_utf8_bulk() noexcept {
+	auto state = state_t<utf8>{};
+	auto expected = std::vector<char32_t>(4096);
+	auto actual = std::vector<char32_t>(4096);
+
+	for (auto seed = std::uint32_t{}; seed < 512; ++seed) {
+		auto const units = random_utf8(seed * 7 % 4000, seed);
+
+		for (auto const capacity : {expected.size(), units.size() / 2, std::size_t{3}}) {
+			auto const e = detail::decode_each<utf8>(state = {}, units, std::span{expected}.first(capacity));
+			auto const a = decode_all<utf8>(state = {}, units, std::span{actual}.first(capacity));
+
+			assert(e.code == a.code);
+			assert(e.src.size() == a.src.size());
+			assert(std::ranges::equal(e.dst, a.dst));
+		}
+
+		auto const v = utf8::validate(state = {}, units);
+		auto const e = detail::decode_each<utf8>(state = {}, units, expected);
+
+		assert(v.code == e.code && v.src.size() == e.src.size());
+	}
+
+	auto const ascii_units = std::vector<char8_t>(1000, u8'x');
+	assert(utf8::validate(state, ascii_units));
+	assert(decode_all<utf8>(state, ascii_units, actual).dst.size() == 1000);
+}
+
+// mostly BMP with valid pairs and stray surrogates sprinkled in, in the byte order of E
+template <typename E>
+std::vector<char16_t> random_utf16(std::size_t const n, std::uint32_t seed) {
+	static constexpr auto pieces = std::array{
+		u"\U0001F600"sv, u"\U0010FFFF"sv, u"\xD800"sv, u"\xDC00"sv, u"\xDBFF\x0041"sv
+	};
+
+	auto out = std::vector<char16_t>{};
+	auto const next = [&] {
+		seed = seed * 1664525u + 1013904223u;
+		return seed >> 8;
+	};
+
+	while (out.size() < n) {
+		auto const r = next();
+
+		if (r % 32) {
+			auto const u = static_cast<char16_t>((r >> 12) % 16 ? 0x20 + r % 0x5F : 0xE000 + r % 0x1000);
+			out.push_back(u);
+		} else {
+			auto const piece = pieces[(r >> 5) % (r & 0x1000 ? pieces.size() : 2)];
+			out.insert(out.end(), piece.begin(), piece.end());
+		}
+	}
+
+	for (auto& u : out) {
+		u = fb::comby::bit::cond_bswap<E::endian>(u);
+	}
+
+	return out;
+}
+
+template <typename E>
+void test_utf16_bulk() noexcept {
+	auto state = state_t<E>{};
+	auto expected = std::vector<char32_t>(4096);
+	auto actual = std::vector<char32_t>(4096);
+
+	for (auto seed = std::uint32_t{}; seed < 512; ++seed) {
+		auto const units = random_utf16<E>(seed * 7 % 4000, seed);
+
+		for (auto const capacity : {expected.size(), units.size() / 2, std::size_t{3}}) {
+			auto const e = detail::decode_each<E>(state = {}, units, std::span{expected}.first(capacity));
+			auto const a = decode_all<E>(state = {}, units, std::span{actual}.first(capacity));
+
+			assert(e.code == a.code);
+			assert(e.src.size() == a.src.size());
+			assert(std::ranges::equal(e.dst, a.dst));
+		}
+	}
+
+	auto units = std::array<char16_t, 2>{};
+	auto codes = std::array<char32_t, 1>{};
+
+	assert(E::encode(state, std::array<char32_t, 1>{0x10437u}, units));
+	assert(fb::comby::bit::cond_bswap<E::endian>(units[0]) == 0xD801u);
+	assert(fb::comby::bit::cond_bswap<E::endian>(units[1]) == 0xDC37u);
+	assert(E::decode(state, units, codes) && codes[0] == 0x10437u);
+}
+
+template <typename E>
+void test_utf8_utf16_transcode() noexcept {
+	auto u8_state = state_t<utf8>{};
+	auto u16_state = state_t<E>{};
+	auto expected_units = std::vector<char16_t>(8192);
+	auto actual_units = std::vector<char16_t>(8192);
+	auto expected_bytes = std::vector<char8_t>(16384);
+	auto actual_bytes = std::vector<char8_t>(16384);
+
+	static_assert(detail::has_transcoder<utf8, E>);
+	static_assert(detail::has_transcoder<E, utf8>);
+
+	for (auto seed = std::uint32_t{}; seed < 256; ++seed) {
+		auto const bytes = random_utf8(seed * 13 % 4000, seed);
+		auto const units = random_utf16<E>(seed * 13 % 4000, seed);
+
+		for (auto const capacity : {expected_units.size(), bytes.size() / 3, std::size_t{1}}) {
+			auto const e = detail::transcode_pivot<utf8, E>(u8_state = {}, u16_state, bytes, std::span{expected_units}.first(capacity));
+			auto const a = transcode<utf8, E>(u8_state = {}, u16_state, bytes, std::span{actual_units}.first(capacity));
+
+			assert(e.code == a.code);
+			assert(e.src.size() == a.src.size());
+			assert(std::ranges::equal(e.dst, a.dst));
+		}
+
+		for (auto const capacity : {expected_bytes.size(), units.size(), std::size_t{2}}) {
+			auto const e = detail::transcode_pivot<E, utf8>(u16_state = {}, u8_state, units, std::span{expected_bytes}.first(capacity));
+			auto const a = transcode<E, utf8>(u16_state = {}, u8_state, units, std::span{actual_bytes}.first(capacity));
+
+			assert(e.code == a.code);
+			assert(e.src.size() == a.src.size());
+			assert(std::ranges::equal(e.dst, a.dst));
+		}
+	}
+}
+
+void test_bswap() noexcept {
+	using fb::comby::bit::bswap;
+
+	static_assert(bswap(std::uint16_t{0x1122u}) == 0x2211u);
+	static_assert(bswap(std::uint32_t{0x11223344u}) == 0x44332211u);
+	static_assert(bswap(std::uint64_t{0x1122334455667788u}) == 0x8877665544332211u);
+	static_assert(bswap(char16_t{0xD801u}) == char16_t{0x01D8u});
+	static_assert(bswap(char32_t{0x0010FFFFu}) == char32_t{0xFFFF1000u});
+	static_assert(fb::comby::bit::detail::bswap_loop(std::uint32_t{0x11223344u}) == 0x44332211u);
+
+	auto const check = [](auto const& src) {
+		using I = typename std::remove_cvref_t<decltype(src)>::value_type;
+
+		auto dst = std::vector<I>(src.size());
+		fb::comby::simd::bswap_span(std::span<I const>{src}, std::span<I>{dst});
+
+		for (auto i = std::size_t{}; i < src.size(); ++i) {
+			assert(dst[i] == bswap(src[i]));
+		}
+
+		fb::comby::simd::bswap_span(std::span<I>{dst});
+		assert(dst == src);
+	};
+
+	for (auto n : {0, 1, 7, 8, 15, 16, 17, 33, 100}) {
+		auto u16 = std::vector<std::uint16_t>(n);
+		auto u32 = std::vector<char32_t>(n);
+		auto u64 = std::vector<std::uint64_t>(n);
+
+		for (auto i = 0; i < n; ++i) {
+			u16[i] = static_cast<std::uint16_t>(0x0102u * (i + 1));
+			u32[i] = static_cast<char32_t>(0x01020304u * (i + 1));
+			u64[i] = 0x0102030405060708u * (i + 1);
+		}
+
+		check(u16);
+		check(u32);
+		check(u64);
+	}
+}
+
+template <typename E>
+void test_utf32_bulk() noexcept {
+	auto state = state_t<E>{};
+	auto codes = std::vector<char32_t>(3000);
+
+	for (auto i = std::size_t{}; i < codes.size(); ++i) {
+		codes[i] = static_cast<char32_t>(i * 997 % 0x110000);
+	}
+
+	auto expected = std::vector<char32_t>(codes.size());
+	auto actual = std::vector<char32_t>(codes.size());
+
+	for (auto const capacity : {codes.size(), std::size_t{40}, std::size_t{54}}) {
+		auto const e = detail::encode_each<E>(state, codes, std::span{expected}.first(capacity));
+		auto const a = encode_all<E>(state, codes, std::span{actual}.first(capacity));
+
+		assert(e.code == a.code && e.src.size() == a.src.size());
+		assert(std::ranges::equal(e.dst, a.dst));
+	}
+
+	auto units = std::vector<char32_t>(codes.size());
+	std::ranges::transform(codes, units.begin(), [](auto const cp) { return fb::comby::bit::cond_bswap<E::endian>(cp); });
+
+	for (auto const capacity : {codes.size(), std::size_t{40}, std::size_t{54}}) {
+		auto const e = detail::decode_each<E>(state, units, std::span{expected}.first(capacity));
+		auto const a = decode_all<E>(state, units, std::span{actual}.first(capacity));
+
+		assert(e.code == a.code && e.src.size() == a.src.size());
+		assert(std::ranges::equal(e.dst, a.dst));
+	}
+
+	auto scalars = std::vector<char32_t>{};
+	std::ranges::copy_if(codes, std::back_inserter(scalars), is_unicode_scalar);
+	assert(encode_all<E>(state, scalars, actual));
+}
+
+template <typename E>
+void test_utf16_encode_all() noexcept {
+	auto state = state_t<E>{};
+	auto codes = std::vector<char32_t>(3000);
+
+	for (auto i = std::size_t{}; i < codes.size(); ++i) {
+		codes[i] = static_cast<char32_t>(i % 64 ? i * 31 % 0xD800 : i * 997 % 0x110000);
+	}
+
+	auto expected = std::vector<char16_t>(2 * codes.size());
+	auto actual = std::vector<char16_t>(2 * codes.size());
+
+	for (auto const capacity : {expected.size(), std::size_t{64}, std::size_t{65}}) {
+		auto const e = detail::encode_each<E>(state, codes, std::span{expected}.first(capacity));
+		auto const a = encode_all<E>(state, codes, std::span{actual}.first(capacity));
+
+		assert(e.code == a.code && e.src.size() == a.src.size());
+		assert(std::ranges::equal(e.dst, a.dst));
+	}
+}
+
+void test_decode_view() noexcept {
+	auto const text = std::u8string{u8"a\u0400\xC3\U0010AAAA\xED\xA0\x80z"};
+	auto const view = text | views::decode<utf8>;
+
+	static_assert(std::forward_iterator<decltype(view.begin())>);
+	static_assert(sizeof(view.begin()) <= 4 * sizeof(void*));
+
+	auto const expected = U"a\u0400\uFFFD\U0010AAAA\uFFFDz"sv;
+	assert(std::ranges::equal(view, expected));
+
+	auto it = view.begin();
+	std::ranges::advance(it, 2);
+	assert(it.code() == result_code::INVALID_ENCODING && it.base() - text.begin() == 3);
+
+	std::ranges::advance(it, 2);
+	assert(it.code() == result_code::INVALID_CODE_POINT && it.units() == 3);
+
+	// non contiguous ranges decode from a copy of the next few units
+	auto const units = std::list<char16_t>{u'x', 0xD83Du, 0xDE00u, u'y'};
+	assert(std::ranges::equal(units | views::decode<utf16>, U"x\U0001F600y"sv));
+
+	// parsers can run directly over the decoded code points
+	auto digits = fb::comby::as_parser<char32_t, int, int>([](auto pos, auto end, auto& r) {
+		auto n = 0;
+
+		for (; pos != end && *pos >= U'0' && *pos <= U'9'; ++pos) {
+			n = n * 10 + static_cast<int>(*pos - U'0');
+		}
+
+		r.set_value(n, pos);
+	});
+
+	auto const number = std::u8string{u8"1234\u00E9"};
+	auto const numbers = number | views::decode<utf8>;
+	auto const r = fb::comby::parse(digits, numbers.begin(), numbers.end());
+
+	assert(r.value() == 1234 && *r.pos() == U'\u00E9' && r.pos().base() - number.begin() == 4);
+}
+
+template <typename E, typename Units>
+void check_streaming(Units const& units) noexcept {
+	auto expected = std::vector<char32_t>(units.size());
+	auto state = state_t<E>{};
+	auto const whole = decode_all<E>(state, std::span{units}, std::span{expected});
+
+	assert(whole);
+	expected.resize(whole.dst.size());
+
+	// every split of the input into two chunks, and then a unit at a time
+	for (auto split = std::size_t{}; split <= units.size(); ++split) {
+		auto decoder = stream_decoder<E>{};
+		auto actual = std::vector<char32_t>(units.size());
+		auto const a = decoder.feed(std::span{units}.first(split), actual);
+		auto const b = decoder.feed(std::span{units}.subspan(split), std::span{actual}.subspan(a.dst.size()));
+
+		assert(a && b && a.src.size() == split && !decoder.pending());
+		assert(decoder.finish() == result_code::OK);
+		assert(std::ranges::equal(std::span{actual}.first(a.dst.size() + b.dst.size()), expected));
+	}
+
+	auto decoder = stream_decoder<E>{};
+	auto actual = std::vector<char32_t>{};
+
+	for (auto const& u : units) {
+		auto code = std::array<char32_t, 1>{};
+		auto const r = decoder.feed(std::span{&u, 1}, code);
+
+		assert(r);
+		actual.insert(actual.end(), r.dst.begin(), r.dst.end());
+	}
+
+	assert(actual == expected && decoder.finish() == result_code::OK);
+}
+
+void test_streaming() noexcept {
+	check_streaming<utf8>(u8"a\u0400b\uFFFD\U0010AAAA\U0001F600z"sv);
+	check_streaming<utf16_le>(std::u16string_view{u"a\u0400\U0001F600b\U0010AAAAc"});
+
+	auto const native = u"\U0001F600x\uE000\U0010FFFF"sv;
+	auto be = std::vector<char16_t>(native.begin(), native.end());
+
+	for (auto& u : be) {
+		u = fb::comby::bit::cond_bswap<std::endian::big>(u);
+	}
+
+	check_streaming<utf16_be>(be);
+
+	// a lone lead unit waits for more input instead of failing
+	auto u8_state = state_t<utf8>{};
+	auto code = std::array<char32_t, 1>{};
+	auto const lead = u8"\u20AC"sv;
+	auto const r = utf8::decode(u8_state, std::span{lead}.first(1), code);
+
+	assert(r.code == result_code::NOT_ENOUGH_INPUT && r.src.size() == 1 && u8_state != state_t<utf8>{});
+	assert(utf8::decode(u8_state, std::span{lead}.subspan(1), code) && code[0] == 0x20ACu);
+
+	auto decoder = stream_decoder<utf8>{};
+
+	assert(decoder.feed(std::span{lead}.first(2), code) && decoder.pending());
+	assert(decoder.finish() == result_code::INVALID_ENCODING && !decoder.pending());
+}
+
+// cached_locale must agree with locale, which asks libc every time
+void check_cached_locale(codeset const kind) noexcept {
+	cached_locale::reload();
+	assert(cached_locale::kind() == kind);
+
+	for (auto i = 0; i < 256; ++i) {
+		auto const unit = static_cast<char>(i);
+		auto expected = std::array<char32_t, 1>{};
+		auto actual = std::array<char32_t, 1>{};
+		auto expected_state = state_t<locale>{};
+		auto actual_state = state_t<cached_locale>{};
+		auto const e = locale::decode(expected_state, std::span{&unit, 1}, expected);
+		auto const a = cached_locale::decode(actual_state, std::span{&unit, 1}, actual);
+
+		// libc and base_utf8 reject invalid UTF-8 lead bytes in different ways
+		assert(kind == codeset::UTF_8 || e.code == a.code);
+		assert(!e || (a && expected == actual));
+	}
+
+	auto const text = "plain \xC3\xA9t\xE9 \xE2\x82\xAC\x80 \xF0\x9F\x98\x80 tail"sv;
+
+	for (auto n = std::size_t{}; n <= text.size(); ++n) {
+		auto expected = std::vector<char32_t>(text.size());
+		auto actual = std::vector<char32_t>(text.size());
+		auto expected_state = state_t<locale>{};
+		auto actual_state = state_t<cached_locale>{};
+		auto const e = detail::decode_each<locale>(expected_state, text.substr(0, n), expected);
+		auto const a = decode_all<cached_locale>(actual_state, text.substr(0, n), actual);
+
+		assert(e.code == a.code && e.src.size() == a.src.size() && std::ranges::equal(e.dst, a.dst));
+
+		if (e) {
+			auto units = std::vector<char>(text.size());
+			auto const r = encode_all<cached_locale>(actual_state, e.dst, units);
+
+			assert(r && std::ranges::equal(r.dst, text.substr(0, r.dst.size())));
+		}
+	}
+}
+
+void test_cached_locale() noexcept {
+	if (std::setlocale(LC_ALL, "C")) {
+		check_cached_locale(codeset::SINGLE_BYTE);
+	}
+
+	if (std::setlocale(LC_ALL, "C.UTF-8")) {
+		check_cached_locale(codeset::UTF_8);
+	}
+
+	std::setlocale(LC_ALL, "C");
+	cached_locale::reload();
+}
+
 int main(int argc, char const* args[]) {
 	test_utf8();
 	test_utf16();
 	test_utf32();
 
+	// every kernel level the cpu can run must give the same results
+	using fb::comby::dispatch::level;
+
+	for (auto const l : {level::SCALAR, level::SSE2, level::SSE4_2, level::AVX2, level::AVX512}) {
+		if (fb::comby::dispatch::force_level(l) != l) {
+			break;
+		}
+
+		test_bulk();
+		test_utf8_bulk();
+		test_utf16_bulk<utf16_le>();
+		test_utf16_bulk<utf16_be>();
+		test_utf8_utf16_transcode<utf16_le>();
+		test_utf8_utf16_transcode<utf16_be>();
+		test_bswap();
+		test_utf32_bulk<utf32_le>();
+		test_utf32_bulk<utf32_be>();
+		test_utf16_encode_all<utf16_le>();
+		test_utf16_encode_all<utf16_be>();
+	}
+
+	fb::comby::dispatch::force_level(fb::comby::dispatch::supported_level());
+	test_decode_view();
+	test_streaming();
+	test_cached_locale();
+
 	return 0;
 }
@@ -0,0 +1,990 @@
+#include <cassert>
+#include <cstddef>
+#include <cstdio>
+#include <deque>
+#include <functional>
+#include <algorithm>
+#include <array>
+#include <memory_resource>
+#include <string>
+#include <vector>
+#include <string_view>
+#include <variant>
+#include <sys/wait.h>
+#include <unistd.h>
+#include "fb/comby/parser.hpp"
+#include "fb/comby/first_set.hpp"
+#include "fb/comby/literal.hpp"
+#include "fb/comby/choice.hpp"
+#include "fb/comby/memo.hpp"
+#include "fb/comby/arena.hpp"
+#include "fb/comby/expect.hpp"
+#include "fb/comby/char_class.hpp"
+#include "fb/comby/utf8_units.hpp"
+#include "fb/comby/mapped_file.hpp"
+#include "fb/comby/parallel.hpp"
+#include "fb/comby/push.hpp"
+#include "fb/comby/line_index.hpp"
+#include "fb/comby/named.hpp"
+#include "fb/comby/operators.hpp"
+#include "fb/comby/utf16.hpp"
+#include "fb/comby/dispatch.hpp"
+
+using namespace std::literals;
+using namespace fb::comby;
+
+template <typename P>
+auto parse_sv(P& p, std::string_view const s) {
+	return parse(p, s.data(), s.data() + s.size());
+}
+
+void test_result() {
+	using small = parser_result<char, int, std::monostate, char const*, char const*>;
+	using rich = parser_result<char, std::string, std::string, char const*, char const*>;
+
+	static_assert(std::is_trivially_copyable_v<small> && sizeof(small) <= 2 * sizeof(char const*));
+	static_assert(!std::is_trivially_copyable_v<rich>);
+
+	auto const text = "abc"sv;
+	auto r = rich{default_result, text.data()};
+	assert(r.index() == 0 && r.error().empty() && r.pos() == text.data());
+
+	r.set_value(std::string(40, 'v'), text.data() + 1);
+	auto copy = r;
+	r.set_error("expected a digit", text.data() + 2);
+
+	assert(copy.has_value() && copy.value() == std::string(40, 'v') && *copy.pos() == 'b');
+	assert(!r.has_value() && r.error() == "expected a digit" && *r.pos() == 'c');
+
+	copy = std::move(r);
+	assert(copy.index() == 0 && copy.error() == "expected a digit");
+
+	auto& v = copy.emplace_value(text.data(), 3, 'x');
+	assert(v == "xxx" && copy.value() == "xxx");
+
+	auto threw = false;
+
+	try {
+		static_cast<void>(copy.error());
+	} catch (std::bad_variant_access const&) {
+		threw = true;
+	}
+
+	assert(threw);
+
+	// a value whose constructor throws leaves nothing behind to destroy, as std::variant does
+	struct throwing {
+		explicit throwing(int const n) {
+			if (n < 0) {
+				throw n;
+			}
+		}
+	};
+
+	using fragile = parser_result<char, throwing, std::string, char const*, char const*>;
+
+	auto f = fragile{default_result, text.data()};
+	f.emplace_error(text.data(), std::string(64, 'a'));
+	threw = false;
+
+	try {
+		f.emplace_value(text.data() + 1, -1);
+	} catch (int) {
+		threw = true;
+	}
+
+	assert(threw && f.valueless_by_exception() && f.index() == std::variant_npos && !f.has_value());
+
+	auto g = f;
+	assert(g.valueless_by_exception());
+
+	f.emplace_value(text.data() + 2, 1);
+	assert(f.has_value() && !f.valueless_by_exception() && *f.pos() == 'c');
+}
+
+void test_literal() noexcept {
+	auto const r = parse(literal<"while">, "while(x)"sv.begin(), "while(x)"sv.end());
+
+	assert(r.index() == 1 && r.value() == "while"sv && *r.pos() == '(');
+
+	auto const text = "whale"sv;
+	auto const e = parse(literal<"while">, text.begin(), text.end());
+
+	assert(e.index() == 0 && e.pos() == text.begin());
+	static_assert(literal_parser<"while">::first == first_set::of(U"w"));
+	static_assert(literal_parser<"">::first.nullable);
+}
+
+void test_choice() noexcept {
+	auto calls = std::size_t{};
+
+	// an identifier can't say what it starts with until it is annotated
+	auto identifier = with_first<first_set::range(U'a', U'z') | first_set::of(U"_")>(
+		as_parser<char, std::string_view, std::monostate>([&](auto pos, auto end, auto& r) {
+			auto const start = pos;
+			++calls;
+
+			for (; pos != end && ((*pos >= 'a' && *pos <= 'z') || *pos == '_'); ++pos) {}
+
+			if (pos == start) {
+				r.set_error({}, pos);
+			} else {
+				r.set_value(std::string_view{start, pos}, pos);
+			}
+		}));
+
+	auto ops = choice(literal<"+">, literal<"-">, literal<"*">, literal<"/">, literal<"(">, literal<")">);
+	static_assert(decltype(ops)::disjoint);
+	static_assert(std::is_same_v<parser_value_t<decltype(ops)>, std::string_view>);
+
+	assert(parse_sv(ops, "*2").value() == "*"sv);
+	assert(parse_sv(ops, "2").index() == 0);
+	assert(parse_sv(ops, "").index() == 0);
+
+	// keywords overlap with identifiers, which are only tried once the keyword fails
+	auto words = choice(literal<"if">, literal<"in">, literal<"else">, identifier);
+	static_assert(!decltype(words)::disjoint);
+	static_assert(decltype(words)::first == (first_set::range(U'a', U'z') | first_set::of(U"_")));
+
+	assert(parse_sv(words, "if x").value() == "if"sv && calls == 0);
+	assert(parse_sv(words, "index").value() == "in"sv && calls == 0);
+	assert(parse_sv(words, "_tmp").value() == "_tmp"sv && calls == 1);
+	assert(parse_sv(words, "ix").value() == "ix"sv && calls == 2);
+	assert(parse_sv(words, "+").index() == 0 && calls == 2);
+
+	// mixed value types give a variant, and a nested choice brings its first set along
+	auto number = with_first<first_set::range(U'0', U'9')>(
+		as_parser<char, int, std::monostate>([](auto pos, auto end, auto& r) {
+			auto n = 0;
+
+			for (; pos != end && *pos >= '0' && *pos <= '9'; ++pos) {
+				n = n * 10 + (*pos - '0');
+			}
+
+			r.set_value(n, pos);
+		}));
+
+	auto token = choice(number, words);
+	static_assert(std::is_same_v<parser_value_t<decltype(token)>, std::variant<int, std::string_view>>);
+
+	auto const n = parse_sv(token, "42+");
+	assert(n.value().index() == 0 && std::get<0>(n.value()) == 42 && *n.pos() == '+');
+	assert(std::get<1>(parse_sv(token, "else").value()) == "else"sv);
+
+	// an empty literal is nullable, so it is tried at the end of the input and on anything
+	auto maybe_sign = choice(literal<"-">, literal<"">);
+	assert(parse_sv(maybe_sign, "").value() == ""sv);
+	assert(parse_sv(maybe_sign, "-1").value() == "-"sv);
+	assert(parse_sv(maybe_sign, "1").value() == ""sv);
+
+	// wide characters only reach branches that declared them
+	auto wide = choice(literal<U"é">, with_first<first_set::range(0x100, 0x10FFFF)>(
+		as_parser<char32_t, std::u32string_view, std::monostate>([](auto pos, auto, auto& r) {
+			r.set_value(std::u32string_view{pos, pos + 1}, pos + 1);
+		})));
+
+	auto const text = U"中é"sv;
+	assert(parse(wide, text.begin(), text.end()).value() == U"中"sv);
+	assert(parse(wide, text.begin() + 1, text.end()).value() == U"é"sv);
+}
+
+void test_one_of_literals() {
+	auto const keywords = one_of_literals<"do", "double", "if", "in", "int", "interface", "=", "==", "=>", "in">;
+	static_assert(decltype(keywords)::first == first_set::of(U"di="));
+
+	auto const words = std::array{"do"sv, "double"sv, "if"sv, "in"sv, "int"sv, "interface"sv, "="sv, "=="sv, "=>"sv};
+
+	// the longest literal the input starts with, checked against every prefix of some awkward inputs
+	auto const longest = [&](std::string_view const s) {
+		auto best = std::size_t{words.size()};
+
+		for (auto i = std::size_t{}; i < words.size(); ++i) {
+			if (s.starts_with(words[i]) && (best == words.size() || words[i].size() > words[best].size())) {
+				best = i;
+			}
+		}
+
+		return best;
+	};
+
+	for (auto const input : {"doubles"sv, "dou"sv, "don"sv, "inter"sv, "interface"sv, "interfaces(x)"sv, "int x"sv, "==>"sv, "=>"sv, "i"sv, "x"sv, ""sv}) {
+		for (auto n = std::size_t{}; n <= input.size(); ++n) {
+			// copied so nothing readable follows the input, as at the end of a buffer
+			auto const text = std::string{input.substr(0, n)};
+			auto const r = parse_sv(keywords, text);
+			auto const expected = longest(text);
+
+			if (expected == words.size()) {
+				assert(r.index() == 0 && r.pos() == text.data());
+			} else {
+				assert(r.value() == expected && r.pos() == text.data() + words[expected].size());
+			}
+
+			auto const units = std::deque<char>(text.begin(), text.end());
+			auto const d = parse(keywords, units.begin(), units.end());
+			assert(d.index() == r.index() && (d.index() == 0 || d.value() == r.value()));
+		}
+	}
+
+	// wide characters take the sibling lists, and a lone literal is a single run
+	auto const arrows = one_of_literals<U"→", U"⇒", U"->">;
+	auto const text = U"⇒ x"sv;
+	assert(parse(arrows, text.begin(), text.end()).value() == 1);
+	assert(parse_sv(one_of_literals<"select">, "selection").value() == 0);
+	assert(parse_sv(one_of_literals<"select">, "selec").index() == 0);
+}
+
+// whether chars() takes C, a wide code point has no room in its class and isn't a constant
+template <char32_t C>
+concept byte_chars = requires { typename std::integral_constant<std::size_t, chars({std::array{C}.data(), 1}).wide_size>; };
+
+void test_char_class() {
+	constexpr auto cjk = ranges({{0x4E00, 0x9FFF}, {0x3040, 0x30FF}, {0x3100, 0x310F}});
+	static_assert(cjk.wide_size == 2 && cjk.wide[0] == code_range{0x3040, 0x310F});
+	static_assert(cjk.contains(U'中') && cjk.contains(0x3105) && !cjk.contains(0x3110) && !cjk.contains(U'a'));
+	static_assert((~classes::digit).contains(0x10FFFF) && !(~classes::digit).contains(U'7'));
+	static_assert((~cjk).contains(U'a') && !(~cjk).contains(0x4E01) && (~cjk).contains(0xA000));
+	static_assert((~chars(U"\n")).only_excluded_byte() == '\n' && classes::alpha.only_excluded_byte() == -1);
+	static_assert(byte_chars<U'a'> && byte_chars<0xFF> && !byte_chars<0x100> && !byte_chars<U'中'>);
+
+	auto const digit = one_of<classes::digit>;
+	assert(parse_sv(digit, "7x").value() == '7' && parse_sv(digit, "x7").index() == 0);
+	static_assert(decltype(digit)::first == first_set::range(U'0', U'9'));
+
+	auto const wide = U"中文abc"sv;
+	auto const w = parse(take_while<cjk, char32_t>, wide.begin(), wide.end());
+	assert(w.value() == U"中文"sv);
+
+	// a wide unit is judged whole, U+4E2D is not '-' however its low byte reads
+	auto const dash = one_of<chars(U"-")>;
+	assert(parse(dash, wide.begin(), wide.end()).index() == 0);
+	assert(parse(skip_while<chars(U"-")>, wide.begin(), wide.end()).value() == 0);
+	assert(parse(one_of<cjk, char32_t>, wide.begin(), wide.end()).value() == U'中');
+
+	// every byte value against every kernel, with runs ending at each offset of a block
+	auto text = std::string{};
+
+	for (auto i = 0; i < 256; ++i) {
+		text += static_cast<char>(i);
+	}
+
+	for (auto const l : {dispatch::level::SCALAR, dispatch::level::SSE2, dispatch::level::SSE4_2, dispatch::level::AVX2, dispatch::level::AVX512}) {
+		if (dispatch::force_level(l) != l) {
+			continue;
+		}
+
+		for (auto c = 0; c < 256; ++c) {
+			auto const run = std::string(static_cast<std::size_t>(c % 70), 'a') + static_cast<char>(c) + "abc";
+			auto const ident = parse_sv(take_while<classes::ident>, run);
+			auto const is_ident = (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9') || c == '_';
+
+			assert(ident.value().size() == static_cast<std::size_t>(c % 70) + (is_ident ? 4 : 0));
+			assert(parse_sv(skip_while<~chars(U"\n")>, run).value() == run.size() - (c == '\n' ? 4 : 0));
+		}
+
+		// the high half goes through the shuffle tables too
+		auto const high = parse_sv(take_while<~classes::alnum>, text);
+		assert(high.value().size() == '0');
+		assert(parse_sv(skip_while<ranges({{0x80, 0xFF}})>, std::string_view{text}.substr(0x80)).value() == 0x80);
+	}
+
+	dispatch::force_level(dispatch::supported_level());
+
+	// at least one is required
+	auto const spaces = take_while<classes::space, char, 1>;
+	assert(parse_sv(spaces, " \t x").value() == " \t "sv && parse_sv(spaces, "x").index() == 0);
+	static_assert(!decltype(spaces)::first.nullable && take_while_parser<classes::space>::first.nullable);
+}
+
+void test_utf8_units() {
+	constexpr auto cjk = ranges({{0x4E00, 0x9FFF}});
+	constexpr auto name = classes::ident | cjk;
+
+	auto const parse_u8 = [](auto const& p, std::u8string_view const s) {
+		return parse(p, s.data(), s.data() + s.size());
+	};
+
+	// ASCII keywords straight off the units, the name decodes only its CJK characters
+	auto const text = u8"let 变量_1 = 2"sv;
+	auto const let = parse_u8(literal<u8"let">, text);
+	auto const space = parse(take_while<classes::space, char8_t>, let.pos(), text.data() + text.size());
+	auto const n = parse(utf8_take_while<name, 1>, space.pos(), text.data() + text.size());
+	assert(n.value() == u8"变量_1"sv && *n.pos() == u8' ');
+
+	static_assert(utf8_take_while_parser<name, 1>::first.contains(U'_') && utf8_take_while_parser<name, 1>::first.contains(0xE4));
+	static_assert(!utf8_take_while_parser<classes::ident, 1>::first.contains(0xE4));
+	static_assert(!utf8_take_while_parser<name, 1>::first.contains(0x80) && !utf8_take_while_parser<name, 1>::first.contains(0xC0));
+
+	// the run ends before anything malformed, however it starts
+	for (auto const bad : {u8"ab\xC3\x28"sv, u8"ab\xE4\xB8"sv, u8"ab\xED\xA0\x80"sv, u8"ab\xC0\xAF"sv, u8"ab\x80"sv}) {
+		assert(parse_u8(utf8_take_while<~chars(U" ")>, bad).value() == u8"ab"sv);
+		assert(parse_u8(utf8_one_of<~chars(U" ")>, bad.substr(2)).index() == 0);
+	}
+
+	// long enough for the ASCII to go through the shuffle kernel between the decoded characters
+	auto const mixed = u8"abcdefghijklmnopqrstuvwxyz中abcdefghijklmnopqrstuvwxyz_文0123456789abcdefghijklmnopq!"sv;
+	assert(parse_u8(utf8_take_while<name>, mixed).value() == mixed.substr(0, mixed.size() - 1));
+	assert(parse_u8(utf8_take_while<classes::ident>, mixed).value() == u8"abcdefghijklmnopqrstuvwxyz"sv);
+	assert(parse_u8(utf8_take_while<name, 100>, mixed).index() == 0);
+
+	assert(parse_u8(utf8_one_of<cjk>, u8"中"sv).value() == U'中');
+	assert(parse_u8(utf8_one_of<cjk>, u8"é"sv).index() == 0);
+	assert(parse_u8(utf8_one_of<classes::digit>, u8"7"sv).value() == U'7');
+
+	// a rule written over code points, whose units are checked once it is done
+	auto const letters = utf8_decoded(as_parser<char32_t, std::size_t, int>([](auto pos, auto end, auto& r) {
+		auto count = std::size_t{};
+
+		for (; pos != end && *pos != U' '; ++pos) {
+			++count;
+		}
+
+		r.set_value(count, pos);
+	}));
+
+	auto const w = parse_u8(letters, u8"héllo wörld"sv);
+	assert(w.value() == 5 && *w.pos() == u8' ');
+
+	auto const e = parse_u8(letters, u8"hé\xFFllo"sv);
+	assert(e.index() == 0 && e.error() == 0 && *e.pos() == 0xFF);
+}
+
+void test_const() {
+	// one immutable grammar, its parsers only read themselves
+	static auto const digit = as_parser<char, int, std::monostate>([](auto pos, auto end, auto& r) {
+		if (pos == end || *pos < '0' || *pos > '9') {
+			r.set_error({}, pos);
+		} else {
+			r.set_value(*pos - '0', pos + 1);
+		}
+	});
+
+	static auto const grammar = choice(expect(0, digit), expect(1, with_first<first_set::of(U"x")>(
+		as_parser<char, int, std::monostate>([](auto pos, auto, auto& r) {
+			r.set_value(-1, pos + 1);
+		}))));
+
+	static_assert(std::is_invocable_v<parse_t const&, decltype(grammar)&, char const*, char const*>);
+	assert(parse_sv(grammar, "7").value() == 7);
+
+	auto ctx = parse_context{};
+	auto const x = "x"sv;
+	assert(parse(grammar, x.data(), x.data() + x.size(), ctx).value() == -1);
+
+	// state kept in the callable needs a mutable parser
+	auto count = as_parser<char, int, std::monostate>([n = 0](auto pos, auto, auto& r) mutable {
+		r.set_value(++n, pos);
+	});
+
+	static_assert(!std::is_invocable_v<parse_t const&, decltype(count) const&, char const*, char const*>);
+	assert(parse_sv(count, "").value() == 1 && parse_sv(count, "").value() == 2);
+}
+
+void test_memo() noexcept {
+	auto calls = std::size_t{};
+
+	// a run of 'a', every alternative below starts with it
+	auto run = as_parser<char, std::size_t, std::monostate>([&](auto pos, auto end, auto& r) {
+		auto const start = pos;
+		++calls;
+
+		for (; pos != end && *pos == 'a'; ++pos) {}
+
+		r.set_value(static_cast<std::size_t>(pos - start), pos);
+	});
+
+	auto const memo_run = memo<char const*>(run);
+
+	// run 'x' | run 'y' | run, backtracking to the same position each time
+	auto const alternatives = [](auto const& rule, std::string_view const s, auto&... ctx) {
+		for (auto const c : "xy"sv) {
+			auto const r = parse(rule, s.data(), s.data() + s.size(), ctx...);
+
+			if (r.pos() != s.data() + s.size() && *r.pos() == c) {
+				return c;
+			}
+		}
+
+		return parse(rule, s.data(), s.data() + s.size(), ctx...).index() == 1 ? '-' : '!';
+	};
+
+	auto const text = "aaaz"sv;
+	assert(alternatives(run, text) == '-' && calls == 3);
+
+	// without a memo_context there is nowhere to keep results
+	calls = 0;
+	assert(alternatives(memo_run, text) == '-' && calls == 3);
+
+	calls = 0;
+	auto ctx = memo_context<char const*>{text.data()};
+	assert(alternatives(memo_run, text, ctx) == '-' && calls == 1);
+	assert(ctx.hits() == 2 && ctx.misses() == 1);
+
+	auto const r = parse(memo_run, text.data(), text.data() + text.size(), ctx);
+	assert(r.value() == 3 && *r.pos() == 'z' && calls == 1);
+
+	// a new input has to be announced, or the old results would be handed out
+	auto const other = "aay"sv;
+	ctx.reset(other.data());
+	assert(alternatives(memo_run, other, ctx) == 'y' && calls == 2);
+
+	// the grammar is shared, each context keeps its own tables
+	auto second = memo_context<char const*>{other.data()};
+	assert(alternatives(memo_run, other, second) == 'y' && calls == 3);
+	assert(ctx.hits() == 1 && second.hits() == 1);
+
+	// a bounded table evicts a position once another one lands in its slot
+	auto const window = memo<char const*>(run, 2);
+	calls = 0;
+	ctx.reset(text.data());
+
+	for (auto const i : {0, 1, 0, 2, 0, 1}) {
+		parse(window, text.data() + i, text.data() + text.size(), ctx);
+	}
+
+	assert(calls == 4 && ctx.hits() == 2);
+	static_assert(decltype(window)::first == first_set::any());
+}
+
+// counts what reaches the global allocator
+struct counting_resource : std::pmr::memory_resource {
+	std::size_t allocations = 0;
+	std::size_t deallocations = 0;
+
+	void* do_allocate(std::size_t const bytes, std::size_t const align) override {
+		++allocations;
+		return std::pmr::new_delete_resource()->allocate(bytes, align);
+	}
+
+	void do_deallocate(void* const p, std::size_t const bytes, std::size_t const align) override {
+		++deallocations;
+		std::pmr::new_delete_resource()->deallocate(p, bytes, align);
+	}
+
+	bool do_is_equal(std::pmr::memory_resource const& other) const noexcept override {
+		return this == &other;
+	}
+};
+
+void test_arena() {
+	using words_type = std::pmr::vector<std::pmr::string>;
+
+	// comma separated words, the list is built in whatever the context hands out
+	auto const words_ending = [](char const terminator) {
+		return as_parser<char, words_type, std::monostate>([=](auto pos, auto end, auto& r, parse_context& ctx) {
+			auto words = words_type{ctx.allocator()};
+
+			while (true) {
+				auto const start = pos;
+
+				for (; pos != end && *pos >= 'a' && *pos <= 'z'; ++pos) {}
+
+				// long enough to never fit a small string
+				words.emplace_back(start, pos).append(32, '.');
+
+				if (pos == end || *pos != ',') {
+					break;
+				}
+
+				++pos;
+			}
+
+			if (pos == end || *pos != terminator) {
+				r.set_error({}, pos);
+			} else {
+				r.set_value(std::move(words), pos + 1);
+			}
+		});
+	};
+
+	// the first branch builds the whole list before failing on the terminator
+	auto list = choice(words_ending(';'), words_ending('.'));
+	auto const text = "alpha,beta,gamma,delta."sv;
+
+	auto upstream = counting_resource{};
+	auto storage = std::array<std::byte, 256>{};
+
+	{
+		auto a = arena{storage, &upstream};
+		auto ctx = a.context();
+		auto const r = parse(list, text.data(), text.data() + text.size(), ctx);
+
+		assert(r.index() == 1 && r.value().size() == 4 && r.value()[3].starts_with("delta."));
+		assert(r.value().get_allocator().resource() == a.resource());
+
+		// a few growing blocks for the whole parse, and nothing freed on backtracking
+		assert(upstream.allocations > 0 && upstream.allocations < 8);
+		assert(upstream.deallocations == 0);
+	}
+
+	assert(upstream.deallocations == upstream.allocations);
+
+	// parsers that don't take a context are still reached through one
+	auto ctx = parse_context{};
+	auto const w = parse(literal<"while">, text.data(), text.data() + text.size(), ctx);
+	assert(w.index() == 0);
+
+	// a context handed to the memo is also the one its rule builds values with
+	auto a = arena{};
+	auto memo_ctx = memo_context<char const*>{text.data(), a.resource()};
+	auto const memo_list = memo<char const*>(list);
+	auto const m = parse(memo_list, text.data(), text.data() + text.size(), memo_ctx);
+	assert(m.value().size() == 4 && m.value().get_allocator().resource() == a.resource());
+	assert(parse(memo_list, text.data(), text.data() + text.size(), memo_ctx).value().size() == 4 && memo_ctx.hits() == 1);
+}
+
+void test_expect() {
+	enum : expected_id { NAME, EQUALS, NUMBER, TRUE };
+
+	auto passes = std::size_t{};
+
+	auto name = expect(NAME, as_parser<char, std::string_view, std::monostate>([](auto pos, auto end, auto& r) {
+		auto const start = pos;
+
+		for (; pos != end && *pos >= 'a' && *pos <= 'z'; ++pos) {}
+
+		if (pos == start) {
+			r.set_error({}, pos);
+		} else {
+			r.set_value(std::string_view{start, pos}, pos);
+		}
+	}));
+
+	auto number = expect(NUMBER, as_parser<char, int, std::monostate>([](auto pos, auto end, auto& r) {
+		if (pos == end || *pos < '0' || *pos > '9') {
+			r.set_error({}, pos);
+		} else {
+			r.set_value(*pos - '0', pos + 1);
+		}
+	}));
+
+	auto value = choice(number, expect(TRUE, as_parser<char, int, std::monostate>([](auto pos, auto end, auto& r) {
+		auto l = parse(literal<"true">, pos, end);
+
+		if (l.index() == 0) {
+			r.set_error({}, pos);
+		} else {
+			r.set_value(1, l.pos());
+		}
+	})));
+
+	auto equals = expect(EQUALS, literal<"=">);
+
+	// name '=' value
+	auto assignment = as_parser<char, int, failure>([&](auto pos, auto end, auto& r, auto& ctx) {
+		++passes;
+
+		auto n = parse(name, pos, end, ctx);
+		if (n.index() == 0) {
+			r.set_error(n.error(), n.pos());
+			return;
+		}
+
+		auto e = parse(equals, n.pos(), end, ctx);
+		if (e.index() == 0) {
+			r.set_error(e.error(), e.pos());
+			return;
+		}
+
+		auto v = parse(value, e.pos(), end, ctx);
+		if (v.index() == 0) {
+			r.set_error(v.error(), v.pos());
+			return;
+		}
+
+		r.set_value(v.value(), v.pos());
+	});
+
+	static_assert(std::is_trivially_copyable_v<failure> && sizeof(failure) == sizeof(expected_id));
+
+	auto const ok = "x=true"sv;
+	auto const r = parse_with_diagnostics(assignment, ok.begin(), ok.end());
+	assert(r.index() == 1 && r.value() == 1 && passes == 1);
+
+	// both branches of the value fail at the same offset, the diagnostic names both
+	auto const bad = "x=?"sv;
+	passes = 0;
+	auto const d = parse_with_diagnostics(assignment, bad.begin(), bad.end());
+	assert(d.index() == 0 && passes == 2);
+	assert(d.error().offset == 2 && *d.pos() == '?');
+	assert((d.error().expected == std::vector<expected_id>{NUMBER, TRUE}));
+
+	auto const missing = "x 1"sv;
+	auto const m = parse_with_diagnostics(assignment, missing.begin(), missing.end());
+	assert(m.error().offset == 1 && (m.error().expected == std::vector<expected_id>{EQUALS}));
+
+	// a context reused for another input measures from its start and starts without failures
+	auto ctx = failure_context<char const*>{missing.data()};
+	assert(parse(assignment, missing.data(), missing.data() + missing.size(), ctx).index() == 0);
+	assert(ctx.furthest() == 1 && ctx.expected() == EQUALS);
+
+	ctx.reset(bad.data());
+	assert(ctx.furthest() == 0 && ctx.expected() == no_expected && !ctx.diagnosing());
+	assert(parse(assignment, bad.data(), bad.data() + bad.size(), ctx).index() == 0);
+	assert(ctx.furthest() == 2 && ctx.expected() == NUMBER);
+
+	// without a context a failure is still just the id
+	auto const f = parse(equals, missing.begin() + 1, missing.end());
+	assert(f.index() == 0 && f.error() == failure{EQUALS});
+}
+
+void test_mapped_file() {
+	auto const text = "while (x) y;"sv;
+
+	// a regular file is mapped
+	auto* const tmp = std::tmpfile();
+	assert(tmp);
+	std::fwrite(text.data(), 1, text.size(), tmp);
+	std::fflush(tmp);
+
+	auto const file = mapped_file<char>{fileno(tmp)};
+	assert(file.mapped() && file.view() == text);
+
+	auto const r = parse(literal<"while">, file.begin(), file.end());
+	assert(r.index() == 1 && r.pos() == file.begin() + 5);
+
+	// units are whole, a trailing odd byte is dropped
+	auto const wide = mapped_file<char16_t>{fileno(tmp), {.hint = access_hint::random, .prefetch = true}};
+	assert(wide.size() == text.size() / 2);
+
+	std::fclose(tmp);
+
+	// a pipe can't be mapped and is read to its end, which takes more than one growth here
+	int fds[2];
+	assert(!pipe(fds));
+
+	auto const big = std::string(100000, 'a') + "!";
+
+	auto const writer = fork();
+
+	if (!writer) {
+		close(fds[0]);
+
+		for (auto left = std::string_view{big}; !left.empty();) {
+			left.remove_prefix(static_cast<std::size_t>(write(fds[1], left.data(), left.size())));
+		}
+
+		_exit(0);
+	}
+
+	close(fds[1]);
+
+	auto piped = mapped_file<char>{fds[0]};
+	close(fds[0]);
+	waitpid(writer, nullptr, 0);
+
+	assert(!piped.mapped() && piped.view() == big);
+
+	// what was parsed past can be given back, moving keeps the buffer
+	auto const run = parse(skip_while<chars(U"a")>, piped.begin(), piped.end());
+	assert(run.value() == 100000);
+	piped.discard(run.pos());
+
+	auto const moved = std::move(piped);
+	assert(piped.empty() && *run.pos() == '!' && moved.end() == run.pos() + 1);
+
+	auto failed = false;
+
+	try {
+		mapped_file<char>{"/nonexistent/comby"};
+	} catch (std::system_error const&) {
+		failed = true;
+	}
+
+	assert(failed);
+}
+
+void test_parse_records() {
+	// one number per line
+	auto const line = as_parser<char, int, std::monostate>([](auto pos, auto end, auto& r) {
+		auto n = parse(take_while<classes::digit, char, 1>, pos, end);
+
+		if (n.index() == 0 || n.pos() == end || *n.pos() != '\n') {
+			r.set_error({}, n.pos());
+		} else {
+			r.set_value(std::stoi(std::string{n.value()}), n.pos() + 1);
+		}
+	});
+
+	auto text = std::string{};
+
+	for (auto i = 0; i < 5000; ++i) {
+		text += std::to_string(i) + '\n';
+	}
+
+	// chunks far smaller than the input, so every worker steals
+	auto const options = record_options{.threads = 4, .chunk_size = 64};
+	auto const all = parse_records(line, text.data(), text.data() + text.size(), delimited{'\n'}, options);
+
+	assert(!all.error && all.values.size() == 5000);
+
+	for (auto i = 0; i < 5000; ++i) {
+		assert(all.values[i] == i);
+	}
+
+	// the error is the first in the input, at its offset in the whole of it
+	auto const bad = text.find("1234\n");
+	text[bad + 2] = 'x';
+	text[text.find("4321\n") + 1] = 'x';
+
+	auto const broken = parse_records(line, text.data(), text.data() + text.size(), delimited{'\n'}, options);
+	assert(broken.error && broken.error->offset == bad + 2 && broken.values.size() == 1234);
+
+	// each chunk gets a context of its own
+	auto chunks = std::atomic<std::size_t>{};
+	auto const contexts = parse_records(line, text.data(), text.data() + bad, delimited{'\n'}, options, [&](char const* begin) {
+		++chunks;
+		return memo_context<char const*>{begin};
+	});
+
+	assert(!contexts.error && contexts.values.size() == 1234 && chunks > 1);
+
+	// one thread, and nothing to parse
+	assert(parse_records(line, text.data(), text.data() + bad, delimited{'\n'}, {.threads = 1}).values.back() == 1233);
+	assert(parse_records(line, text.data(), text.data()).values.empty());
+}
+
+void test_push_parser() {
+	auto const line = as_parser<char, int, std::monostate>([](auto pos, auto end, auto& r) {
+		auto n = parse(take_while<classes::digit, char, 1>, pos, end);
+
+		if (n.index() == 0 || n.pos() == end || *n.pos() != '\n') {
+			r.set_error({}, n.pos());
+		} else {
+			r.set_value(std::stoi(std::string{n.value()}), n.pos() + 1);
+		}
+	});
+
+	auto numbers = push_parser{line};
+
+	// nothing is decided at the end of what has arrived
+	numbers.feed("12\n3"sv);
+	assert(numbers.next() == 12);
+	assert(!numbers.next() && !numbers.done());
+
+	numbers.feed("4\n56"sv);
+	assert(numbers.next() == 34 && !numbers.next());
+
+	numbers.feed("\n7"sv);
+	assert(numbers.next() == 56 && !numbers.next());
+
+	// the rest is parsed as it stands once the input ends, a 7 without its newline
+	numbers.finish();
+	assert(!numbers.next() && numbers.done());
+	assert(numbers.error() && numbers.error()->offset == 10);
+	assert(!numbers.stalled());
+
+	// a choice waits for the longer branch rather than settling on the shorter one
+	auto words = push_parser{choice(literal<"abcd">, literal<"a">)};
+
+	words.feed("ab"sv);
+	assert(!words.next());
+	words.feed("cda"sv);
+	assert(words.next() == "abcd"sv && !words.next());
+	words.finish();
+	assert(words.next() == "a"sv && !words.next() && words.done() && !words.error());
+
+	// a record matching nothing would repeat forever, it ends the stream without an error
+	auto digits = push_parser{take_while<classes::digit>};
+
+	digits.feed("12a3"sv);
+	assert(digits.next() == "12"sv && !digits.next() && digits.done());
+	assert(!digits.error() && digits.stalled() == 2u);
+
+	// memory follows the record, not the stream
+	auto stream = push_parser{line};
+	auto count = 0;
+
+	for (auto i = 0; i < 20000; ++i) {
+		auto const chunk = std::to_string(i) + '\n';
+
+		stream.feed(chunk);
+
+		while (auto const v = stream.next()) {
+			assert(*v == count++);
+		}
+	}
+
+	stream.finish();
+	assert(!stream.next() && !stream.error() && count == 20000);
+	assert(stream.buffered() == 0 && stream.capacity() < 64);
+}
+
+void test_line_index() {
+	auto const text = u8"first\nsecond line\n\nüber ünits"sv;
+	auto const lines = line_index<encoding::utf8>{text};
+
+	assert(lines.lines() == 4);
+	assert((lines.at(std::size_t{0}) == position{0, 1, 1}));
+	assert((lines.at(std::size_t{5}) == position{5, 1, 6}));
+	assert((lines.at(std::size_t{6}) == position{6, 2, 1}));
+	assert((lines.at(std::size_t{18}) == position{18, 3, 1}));
+
+	// columns are code points, the offset stays in units
+	auto const word = parse(literal<u8"ünits">, text.begin() + 25, text.end());
+	assert((lines.at(word.pos()) == position{31, 4, 11}));
+	assert((lines.at(text.size() + 10) == position{text.size(), 4, 11}));
+
+	// a unit that fails to decode is one column, wherever it falls on the line
+	auto const invalid = std::string_view{"a\xFF" "b\n\xFF" "c"};
+	auto const broken = line_index<encoding::utf8_compat>{invalid};
+
+	assert((broken.at(std::size_t{3}) == position{3, 1, 4}));
+	assert((broken.at(std::size_t{6}) == position{6, 2, 3}));
+
+	// a line running over several blocks starts where the first of them says it does
+	auto const lengthy = std::u8string(3 * line_index<encoding::utf8>::block_size, u8'x') + u8"\n" + std::u8string(10, u8'x');
+	auto const long_lines = line_index<encoding::utf8>{lengthy};
+	auto const across = 2 * line_index<encoding::utf8>::block_size + 5;
+
+	assert((long_lines.at(across) == position{across, 1, across + 1}));
+	assert((long_lines.at(lengthy.size()) == position{lengthy.size(), 2, 11}));
+
+	// a byte swapped encoding finds its newlines too
+	auto const wide = std::u16string{u"a\u0a00\nb"};
+	auto swapped = wide;
+
+	for (auto& c : swapped) {
+		c = bit::bswap(c);
+	}
+
+	assert((line_index<encoding::utf16_le>{wide}.at(std::size_t{3}) == position{3, 2, 1}));
+	assert((line_index<encoding::utf16_be>{swapped}.at(std::size_t{3}) == position{3, 2, 1}));
+
+	// lines long and short across several blocks, against every newline kernel
+	auto big = std::u8string{};
+
+	for (auto i = 0; big.size() < 5 * line_index<encoding::utf8>::block_size; ++i) {
+		big.append(static_cast<std::size_t>(i * 7 % 300), u8'x').append(u8"\n");
+	}
+
+	for (auto const l : {dispatch::level::SCALAR, dispatch::level::SSE2, dispatch::level::SSE4_2, dispatch::level::AVX2, dispatch::level::AVX512}) {
+		if (dispatch::force_level(l) != l) {
+			continue;
+		}
+
+		auto const index = line_index<encoding::utf8>{big};
+
+		// enough matches in a row to wrap a byte counter many times over
+		auto const newlines = std::string(40000, '\n');
+		assert(simd::count_byte(reinterpret_cast<unsigned char const*>(newlines.data()), newlines.size(), '\n') == newlines.size());
+
+		for (auto offset = std::size_t{}; offset <= big.size(); offset += 97) {
+			auto const before = std::u8string_view{big}.substr(0, offset);
+			auto const line = static_cast<std::size_t>(std::count(before.begin(), before.end(), u8'\n')) + 1;
+			auto const start = before.rfind(u8'\n');
+			auto const column = offset - (start == before.npos ? 0 : start + 1) + 1;
+
+			assert((index.at(offset) == position{offset, line, column}));
+		}
+	}
+
+	dispatch::force_level(dispatch::supported_level());
+}
+
+void test_named() {
+	// without FB_COMBY_PROFILE a rule keeps its id but is never counted, see profile.cpp
+	// for the profile itself
+	auto const keyword = named("keyword", choice(literal<"if">, literal<"in">));
+
+	static_assert(detail::profiled<decltype(keyword)>);
+	static_assert(decltype(keyword)::first == first_set::of(U"i"));
+	assert(parse_sv(keyword, "in").value() == "in"sv);
+	assert(profile::rules().at(keyword.profile_rule()).name == "keyword"sv);
+	assert(profile::rules().at(keyword.profile_rule()).calls == 0);
+}
+
+void test_operators() {
+	// values spell out how the operators were grouped
+	auto const binary = [](std::string_view const op) {
+		return [op](std::string const& a, std::string const& b) {
+			return "(" + a + std::string{op} + b + ")";
+		};
+	};
+
+	auto const unary = [](std::string_view const op, bool const before) {
+		return [op, before](std::string const& a) {
+			return before ? "(" + std::string{op} + a + ")" : "(" + a + std::string{op} + ")";
+		};
+	};
+
+	// a letter, or an expression in parentheses through nested
+	auto nested = std::function<parser_result<char, std::string, std::monostate, char const*, char const*>(char const*, char const*)>{};
+	auto const operand = with_first<first_set::range(U'a', U'z') | first_set::of(U"(")>(
+		as_parser<char, std::string, std::monostate>([&](auto pos, auto end, auto& r) {
+			if (pos != end && *pos >= 'a' && *pos <= 'z') {
+				r.set_value(std::string(1, *pos), pos + 1);
+			} else if (pos == end || *pos != '(') {
+				r.set_error(std::monostate{}, pos);
+			} else if (auto const e = nested(pos + 1, end); !e.has_value()) {
+				r = e;
+			} else if (e.pos() == end || *e.pos() != ')') {
+				r.set_error(std::monostate{}, e.pos());
+			} else {
+				r.set_value(e.value(), e.pos() + 1);
+			}
+		}));
+
+	auto const expression = operators(operand,
+		infix<"+", 1>(binary("+")),
+		infix<"-", 1>(binary("-")),
+		infix<"*", 2>(binary("*")),
+		infix<"**", 2>(binary("**")),
+		prefix<"-", 3>(unary("-", true)),
+		infix<"^", 4, assoc::right>(binary("^")),
+		postfix<"!", 5>(unary("!", false)));
+
+	nested = [&](char const* const pos, char const* const end) {
+		return parse(expression, pos, end);
+	};
+
+	static_assert(decltype(expression)::first == (first_set::range(U'a', U'z') | first_set::of(U"(-")));
+
+	auto const grouped = [&](std::string_view const s) {
+		auto const r = parse_sv(expression, s);
+		return r.has_value() && r.pos() == s.data() + s.size() ? r.value() : "!" + std::string{s};
+	};
+
+	assert(grouped("a") == "a");
+	assert(grouped("a+b*c") == "(a+(b*c))");
+	assert(grouped("a*b+c") == "((a*b)+c)");
+	assert(grouped("a-b-c") == "((a-b)-c)");
+	assert(grouped("a^b^c") == "(a^(b^c))");
+	assert(grouped("a**b*c") == "((a**b)*c)");
+	assert(grouped("-a^b") == "(-(a^b))");
+	assert(grouped("-a*b") == "((-a)*b)");
+	assert(grouped("--a-b") == "((-(-a))-b)");
+	assert(grouped("-a!") == "(-(a!))");
+	assert(grouped("a^b!!") == "(a^((b!)!))");
+	assert(grouped("(a+b)*-c") == "((a+b)*(-c))");
+
+	// the expression stops before what it can't read, and a dangling operator fails it
+	auto const r = parse_sv(expression, "a+b)");
+	assert(r.value() == "(a+b)" && *r.pos() == ')');
+	auto const dangling = "a+"sv;
+	auto const e = parse_sv(expression, dangling);
+	assert(e.index() == 0 && e.pos() == dangling.data() + 2);
+	assert(parse_sv(expression, "-").index() == 0);
+	assert(parse_sv(expression, "(a+b").index() == 0);
+}
+
+int main(int argc, char const* args[]) {
+	test_result();
+	test_literal();
+	test_choice();
+	test_one_of_literals();
+	test_char_class();
+	test_utf8_units();
+	test_const();
+	test_memo();
+	test_arena();
+	test_expect();
+	test_mapped_file();
+	test_parse_records();
+	test_push_parser();
+	test_line_index();
+	test_named();
+	test_operators();
+
+	return 0;
+}
@@ -0,0 +1,111 @@
+#define FB_COMBY_PROFILE
+#include <cassert>
+#include <cstddef>
+#include <algorithm>
+#include <string>
+#include <string_view>
+#include <variant>
+#include "fb/comby/parser.hpp"
+#include "fb/comby/literal.hpp"
+#include "fb/comby/choice.hpp"
+#include "fb/comby/char_class.hpp"
+#include "fb/comby/named.hpp"
+#include "fb/comby/parallel.hpp"
+
+using namespace std::literals;
+using namespace fb::comby;
+
+// the parse CPO with FB_COMBY_PROFILE defined, every named rule reports to the profile
+void test_profile() {
+	auto const digits = named("digits", take_while<classes::digit, char, 1>);
+
+	// a number, or a number and a unit, with the longer branch tried first
+	auto const with_unit = named("with_unit", as_parser<char, std::size_t, std::monostate>([&](auto pos, auto end, auto& r) {
+		auto const n = parse(digits, pos, end);
+
+		if (n.index() == 0) {
+			r.set_error({}, n.pos());
+			return;
+		}
+
+		auto const unit = parse(literal<"px">, n.pos(), end);
+
+		if (unit.index() == 0) {
+			r.set_error({}, unit.pos());
+		} else {
+			r.set_value(n.value().size(), unit.pos());
+		}
+	}));
+
+	auto const plain = named("plain", as_parser<char, std::size_t, std::monostate>([&](auto pos, auto end, auto& r) {
+		auto const n = parse(digits, pos, end);
+
+		if (n.index() == 0) {
+			r.set_error({}, n.pos());
+		} else {
+			r.set_value(n.value().size(), n.pos());
+		}
+	}));
+
+	auto const value = named("value", choice(with_unit, plain));
+	static_assert(detail::profiled<decltype(value)>);
+
+	auto const text = "1234"sv;
+	auto const r = parse(value, text.data(), text.data() + text.size());
+	assert(r.value() == 4);
+
+	auto const stats = profile::rules();
+	auto const find = [&](std::string_view const name) {
+		return *std::find_if(stats.begin(), stats.end(), [&](profile::rule_stats const& s) {
+			return s.name == name;
+		});
+	};
+
+	// the first branch matched all the digits, then failed at the end and was backtracked over
+	assert(find("value").calls == 1 && find("value").failures == 0 && find("value").consumed == 4);
+	assert(find("with_unit").calls == 1 && find("with_unit").failures == 1 && find("with_unit").backtracked == 4);
+	assert(find("plain").calls == 1 && find("plain").consumed == 4);
+	assert(find("digits").calls == 2);
+	assert(find("value").total_cycles >= find("with_unit").total_cycles + find("plain").total_cycles);
+
+	auto const flat = profile::flat();
+	assert(flat.starts_with("rule") && flat.find("with_unit") != flat.npos);
+
+	// every path to a rule that spent any time, root first
+	auto const folded = profile::folded();
+	assert(folded.find("value;with_unit;digits ") != folded.npos || folded.find("value;with_unit ") != folded.npos);
+	assert(folded.find("value;plain") != folded.npos);
+	assert(folded.find("\nvalue;") != folded.npos || folded.starts_with("value"));
+
+	// counts from threads that have finished are kept
+	profile::reset();
+	assert(profile::rules()[0].calls == 0);
+
+	auto lines = std::string{};
+
+	for (auto i = 0; i < 1000; ++i) {
+		lines += std::to_string(i) + '\n';
+	}
+
+	auto const line = named("line", as_parser<char, std::size_t, std::monostate>([&](auto pos, auto end, auto& r) {
+		auto const n = parse(value, pos, end);
+
+		if (n.index() == 0 || n.pos() == end || *n.pos() != '\n') {
+			r.set_error({}, n.pos());
+		} else {
+			r.set_value(n.value(), n.pos() + 1);
+		}
+	}));
+
+	auto const all = parse_records(line, lines.data(), lines.data() + lines.size(), delimited{'\n'}, {.threads = 4, .chunk_size = 100});
+	assert(all.values.size() == 1000);
+
+	auto const after = profile::rules();
+	assert(after[0].calls == 2000 && after.back().calls == 1000 && after.back().consumed == lines.size());
+}
+
+int main(int argc, char const* args[]) {
+	test_profile();
+
+	return 0;
+}